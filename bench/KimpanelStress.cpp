@@ -0,0 +1,363 @@
+// Soak test for the whole D-Bus path without fcitx5. Starts a private
+// dbus-daemon, launches kimpanel-lite on it and plays the engine side of the
+// kimpanel protocol: SetLookupTable/SetSpotRect calls and inputmethod signals
+// at a fixed keystroke rate, plus ExecMenu answers to TriggerProperty. The
+// tray's input method cycle is driven through the debug object to time the
+// TriggerProperty -> ExecMenu -> TriggerProperty round trip. Prints one JSON
+// object at the end, e.g.
+//   kimpanel-stress --rate 120 --candidates 9 --duration 30
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusServiceWatcher>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QProcess>
+#include <QStringList>
+#include <QTextStream>
+#include <QTimer>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+const QString PANEL_SERVICE = QStringLiteral("org.kde.impanel");
+const QString PANEL_PATH = QStringLiteral("/org/kde/impanel");
+const QString PANEL_INTERFACE = QStringLiteral("org.kde.impanel");
+const QString PANEL2_INTERFACE = QStringLiteral("org.kde.impanel2");
+const QString DEBUG_PATH = QStringLiteral("/org/kde/impanel/Debug");
+const QString DEBUG_INTERFACE = QStringLiteral("org.deepin.kimpanel.Debug");
+const QString ENGINE_SERVICE = QStringLiteral("org.kde.kimpanel.inputmethod");
+const QString ENGINE_PATH = QStringLiteral("/kimpanel");
+const QString ENGINE_INTERFACE = QStringLiteral("org.kde.kimpanel.inputmethod");
+const QString TRACKED_KEY = QStringLiteral("/Fcitx/im");
+constexpr int MENU_TIMEOUT_MS = 1000;
+// Time for the panel's watcher to resolve our unique name and add its match rules
+constexpr int SUBSCRIBE_GRACE_MS = 500;
+
+struct InputMethod {
+    QString key;
+    QString label;
+    QString icon;
+};
+
+const QVector<InputMethod> &inputMethods() {
+    static const QVector<InputMethod> methods = {
+        {QStringLiteral("/Fcitx/im/pinyin"), QStringLiteral("拼音"), QStringLiteral("fcitx-pinyin")},
+        {QStringLiteral("/Fcitx/im/shuangpin"), QStringLiteral("双拼"), QStringLiteral("fcitx-shuangpin")},
+        {QStringLiteral("/Fcitx/im/keyboard-us"), QStringLiteral("英语"), QStringLiteral("fcitx-keyboard-us")},
+    };
+    return methods;
+}
+
+QString propertyString(const QString &key, const InputMethod &im) {
+    return QStringLiteral("%1:%2:%3:%2:label=%2").arg(key, im.label, im.icon);
+}
+
+struct Samples {
+    std::vector<qint64> us;
+
+    qint64 percentile(double fraction) {
+        if (us.empty()) {
+            return 0;
+        }
+        std::sort(us.begin(), us.end());
+        const size_t index = std::min(us.size() - 1, size_t(fraction * double(us.size())));
+        return us[index];
+    }
+    qint64 max() const { return us.empty() ? 0 : *std::max_element(us.begin(), us.end()); }
+};
+
+class StressEngine : public QObject {
+    Q_OBJECT
+public:
+    struct Options {
+        int rateHz = 60;
+        int candidates = 9;
+        int durationS = 10;
+        int menuCycles = 20;
+    };
+
+    StressEngine(const QDBusConnection &bus, const Options &options, QObject *parent = nullptr)
+        : QObject(parent), bus_(bus), options_(options) {
+        keystrokeTimer_.setTimerType(Qt::PreciseTimer);
+        keystrokeTimer_.setInterval(std::max(1, 1000 / std::max(1, options_.rateHz)));
+        connect(&keystrokeTimer_, &QTimer::timeout, this, &StressEngine::keystroke);
+        menuTimer_.setInterval(std::max(1, options_.durationS * 1000 / std::max(1, options_.menuCycles)));
+        connect(&menuTimer_, &QTimer::timeout, this, &StressEngine::cycleMenu);
+
+        bus_.connect(QString(), PANEL_PATH, PANEL_INTERFACE, QStringLiteral("TriggerProperty"),
+                     this, SLOT(onTriggerProperty(QString)));
+    }
+
+    void start() {
+        emitSignal(QStringLiteral("Enable"), {true});
+        QStringList props;
+        props << propertyString(TRACKED_KEY, inputMethods().at(current_));
+        emitSignal(QStringLiteral("RegisterProperties"), {props});
+
+        clock_.start();
+        keystrokeTimer_.start();
+        if (options_.menuCycles > 0) {
+            menuTimer_.start();
+        }
+        QTimer::singleShot(options_.durationS * 1000, this, &StressEngine::finish);
+    }
+
+signals:
+    void finished();
+
+private slots:
+    void keystroke() {
+        const int n = keystrokes_++;
+        static const QStringList syllables = {
+            QStringLiteral("n"), QStringLiteral("ni"), QStringLiteral("ni'h"),
+            QStringLiteral("ni'ha"), QStringLiteral("ni'hao"),
+        };
+        static const QStringList words = {
+            QStringLiteral("你好"), QStringLiteral("你"), QStringLiteral("呢"), QStringLiteral("泥"),
+            QStringLiteral("拟好"), QStringLiteral("你号"), QStringLiteral("逆"), QStringLiteral("尼"),
+        };
+        const QString &pinyin = syllables.at(n % syllables.size());
+
+        emitSignal(QStringLiteral("UpdatePreeditText"), {pinyin, QString()});
+        emitSignal(QStringLiteral("ShowPreedit"), {true});
+        emitSignal(QStringLiteral("UpdateAux"), {pinyin, QString()});
+        emitSignal(QStringLiteral("ShowAux"), {true});
+
+        QStringList labels;
+        QStringList texts;
+        QStringList comments;
+        for (int i = 0; i < options_.candidates; ++i) {
+            labels << QString::number(i % 10 + 1);
+            texts << words.at((n + i) % words.size());
+            comments << QString();
+        }
+        callPanel(QStringLiteral("SetLookupTable"),
+                  {labels, texts, comments, n % 3 != 0, true, 0, 0});
+        emitSignal(QStringLiteral("ShowLookupTable"), {true});
+        callPanel(QStringLiteral("SetSpotRect"), {200 + (n % 40) * 12, 400, 0, 20});
+    }
+
+    void cycleMenu() {
+        if (menuPending_) {
+            return;
+        }
+        menuPending_ = true;
+        menuClock_.start();
+        bus_.asyncCall(QDBusMessage::createMethodCall(PANEL_SERVICE, DEBUG_PATH, DEBUG_INTERFACE,
+                                                      QStringLiteral("CycleInputMethod")));
+        const int cycle = ++menuCycles_;
+        QTimer::singleShot(MENU_TIMEOUT_MS, this, [this, cycle]() {
+            if (menuPending_ && cycle == menuCycles_) {
+                menuPending_ = false;
+                ++menuTimeouts_;
+            }
+        });
+    }
+
+    void onTriggerProperty(const QString &key) {
+        if (key == TRACKED_KEY) {
+            // First leg: the tray asks for the menu
+            QStringList entries;
+            for (const InputMethod &im : inputMethods()) {
+                entries << propertyString(im.key, im);
+            }
+            emitSignal(QStringLiteral("ExecMenu"), {entries});
+            return;
+        }
+        for (int i = 0; i < inputMethods().size(); ++i) {
+            if (inputMethods().at(i).key != key) {
+                continue;
+            }
+            if (menuPending_) {
+                menuPending_ = false;
+                menuRtt_.us.push_back(menuClock_.nsecsElapsed() / 1000);
+            }
+            // Switch like fcitx would, so the next cycle advances again
+            current_ = i;
+            emitSignal(QStringLiteral("UpdateProperty"), {propertyString(TRACKED_KEY, inputMethods().at(i))});
+            return;
+        }
+    }
+
+    void finish() {
+        keystrokeTimer_.stop();
+        menuTimer_.stop();
+        const double seconds = clock_.elapsed() / 1000.0;
+
+        QTextStream out(stdout);
+        out << "{\"bench\":\"stress\",\"rate_hz\":" << options_.rateHz
+            << ",\"candidates\":" << options_.candidates
+            << ",\"keystrokes\":" << keystrokes_
+            << ",\"keystrokes_per_sec\":" << QString::number(keystrokes_ / std::max(seconds, 0.001), 'f', 1)
+            << ",\"signals_sent\":" << signalsSent_
+            << ",\"calls_sent\":" << callsSent_
+            << ",\"call_errors\":" << callErrors_
+            << ",\"call_rtt_p50_us\":" << callRtt_.percentile(0.50)
+            << ",\"call_rtt_p99_us\":" << callRtt_.percentile(0.99)
+            << ",\"call_rtt_max_us\":" << callRtt_.max()
+            << ",\"menu_cycles\":" << menuCycles_
+            << ",\"menu_timeouts\":" << menuTimeouts_
+            << ",\"menu_rtt_p50_us\":" << menuRtt_.percentile(0.50)
+            << ",\"menu_rtt_p99_us\":" << menuRtt_.percentile(0.99)
+            << ",\"menu_rtt_max_us\":" << menuRtt_.max() << "}\n";
+        out.flush();
+        emit finished();
+    }
+
+private:
+    void emitSignal(const QString &member, const QVariantList &arguments) {
+        auto message = QDBusMessage::createSignal(ENGINE_PATH, ENGINE_INTERFACE, member);
+        message.setArguments(arguments);
+        bus_.send(message);
+        ++signalsSent_;
+    }
+
+    void callPanel(const QString &member, const QVariantList &arguments) {
+        auto message = QDBusMessage::createMethodCall(PANEL_SERVICE, PANEL_PATH, PANEL2_INTERFACE, member);
+        message.setArguments(arguments);
+        ++callsSent_;
+        QElapsedTimer sent;
+        sent.start();
+        auto *watcher = new QDBusPendingCallWatcher(bus_.asyncCall(message), this);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, sent](QDBusPendingCallWatcher *call) {
+            if (call->isError()) {
+                ++callErrors_;
+            } else {
+                callRtt_.us.push_back(sent.nsecsElapsed() / 1000);
+            }
+            call->deleteLater();
+        });
+    }
+
+    QDBusConnection bus_;
+    Options options_;
+    QTimer keystrokeTimer_;
+    QTimer menuTimer_;
+    QElapsedTimer clock_;
+    QElapsedTimer menuClock_;
+    int current_ = 0;
+    int keystrokes_ = 0;
+    quint64 signalsSent_ = 0;
+    quint64 callsSent_ = 0;
+    quint64 callErrors_ = 0;
+    int menuCycles_ = 0;
+    int menuTimeouts_ = 0;
+    bool menuPending_ = false;
+    Samples callRtt_;
+    Samples menuRtt_;
+};
+
+// Private session bus; the address is the first line dbus-daemon prints
+QString startBus(QProcess &daemon) {
+    daemon.setProgram(QStringLiteral("dbus-daemon"));
+    daemon.setArguments({QStringLiteral("--session"), QStringLiteral("--nofork"),
+                         QStringLiteral("--print-address=1")});
+    daemon.start();
+    if (!daemon.waitForStarted() || !daemon.waitForReadyRead(5000)) {
+        return {};
+    }
+    return QString::fromLocal8Bit(daemon.readLine()).trimmed();
+}
+
+void stopProcess(QProcess &process) {
+    if (process.state() == QProcess::NotRunning) {
+        return;
+    }
+    process.terminate();
+    if (!process.waitForFinished(3000)) {
+        process.kill();
+        process.waitForFinished();
+    }
+}
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("kimpanel-stress"));
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption panelOption(QStringLiteral("panel"),
+                                         QStringLiteral("kimpanel-lite binary to launch on the private bus."),
+                                         QStringLiteral("path"),
+                                         QCoreApplication::applicationDirPath() + QStringLiteral("/kimpanel-lite"));
+    const QCommandLineOption platformOption(QStringLiteral("platform"),
+                                            QStringLiteral("QT_QPA_PLATFORM for the panel, e.g. xcb under Xvfb."),
+                                            QStringLiteral("name"),
+                                            QStringLiteral("offscreen"));
+    const QCommandLineOption rateOption(QStringLiteral("rate"),
+                                        QStringLiteral("Keystrokes per second."),
+                                        QStringLiteral("hz"), QStringLiteral("60"));
+    const QCommandLineOption candidatesOption(QStringLiteral("candidates"),
+                                              QStringLiteral("Candidates per lookup table."),
+                                              QStringLiteral("count"), QStringLiteral("9"));
+    const QCommandLineOption durationOption(QStringLiteral("duration"),
+                                            QStringLiteral("Seconds to run."),
+                                            QStringLiteral("seconds"), QStringLiteral("10"));
+    const QCommandLineOption cyclesOption(QStringLiteral("menu-cycles"),
+                                          QStringLiteral("Tray input method cycles to time."),
+                                          QStringLiteral("count"), QStringLiteral("20"));
+    parser.addOptions({panelOption, platformOption, rateOption, candidatesOption, durationOption, cyclesOption});
+    parser.process(app);
+
+    StressEngine::Options options;
+    options.rateHz = std::max(1, parser.value(rateOption).toInt());
+    options.candidates = std::max(0, parser.value(candidatesOption).toInt());
+    options.durationS = std::max(1, parser.value(durationOption).toInt());
+    options.menuCycles = std::max(0, parser.value(cyclesOption).toInt());
+
+    const QString panelPath = parser.value(panelOption);
+    if (!QFileInfo(panelPath).isExecutable()) {
+        qCritical() << "Panel binary not found:" << panelPath;
+        return 1;
+    }
+
+    QProcess daemon;
+    const QString address = startBus(daemon);
+    if (address.isEmpty()) {
+        qCritical() << "Could not start a private dbus-daemon";
+        return 1;
+    }
+    QDBusConnection bus = QDBusConnection::connectToBus(address, QStringLiteral("kimpanel-stress"));
+    if (!bus.isConnected() || !bus.registerService(ENGINE_SERVICE)) {
+        qCritical() << "Could not claim" << ENGINE_SERVICE << "on" << address;
+        stopProcess(daemon);
+        return 1;
+    }
+
+    StressEngine engine(bus, options);
+    QObject::connect(&engine, &StressEngine::finished, &app, &QCoreApplication::quit, Qt::QueuedConnection);
+
+    QDBusServiceWatcher panelWatcher(PANEL_SERVICE, bus, QDBusServiceWatcher::WatchForRegistration);
+    QObject::connect(&panelWatcher, &QDBusServiceWatcher::serviceRegistered, &engine, [&engine]() {
+        QTimer::singleShot(SUBSCRIBE_GRACE_MS, &engine, &StressEngine::start);
+    }, Qt::SingleShotConnection);
+
+    QProcess panel;
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert(QStringLiteral("DBUS_SESSION_BUS_ADDRESS"), address);
+    environment.insert(QStringLiteral("QT_QPA_PLATFORM"), parser.value(platformOption));
+    panel.setProcessEnvironment(environment);
+    panel.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    panel.setStandardOutputFile(QProcess::nullDevice());
+    panel.start(panelPath, {});
+    if (!panel.waitForStarted()) {
+        qCritical() << "Could not launch" << panelPath;
+        stopProcess(daemon);
+        return 1;
+    }
+
+    const int result = app.exec();
+    stopProcess(panel);
+    QDBusConnection::disconnectFromBus(QStringLiteral("kimpanel-stress"));
+    stopProcess(daemon);
+    return result;
+}
+
+#include "KimpanelStress.moc"
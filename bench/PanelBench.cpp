@@ -0,0 +1,281 @@
+// Drives KimpanelAdaptor and PanelWindow headlessly with scripted or recorded
+// panel traffic and prints one JSON object per scenario, e.g.
+//   QT_QPA_PLATFORM=offscreen kimpanel-bench --iterations 5000 typing
+//   kimpanel-bench --replay burst.kpbt replay
+// Each update runs the full path: adaptor slot, scheduler commit, layout,
+// paint and backing store flush.
+
+#include "BusReplayer.h"
+#include "CandidateStrip.h"
+#include "KimpanelAdaptor.h"
+#include "PanelWindow.h"
+#include "StaticTextCache.h"
+
+#include <DApplication>
+
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QStringList>
+#include <QTextStream>
+#include <QVector>
+
+#include <algorithm>
+#include <functional>
+
+#include <sys/resource.h>
+#include <time.h>
+
+DWIDGET_USE_NAMESPACE
+
+namespace {
+constexpr int DEFAULT_ITERATIONS = 2000;
+constexpr int WARMUP_ITERATIONS = 200;
+// Longest wait for the panel to paint after it is shown
+constexpr qint64 FIRST_FRAME_TIMEOUT_NS = 500 * 1000 * 1000;
+
+struct Scenario {
+    const char *name;
+    // Feeds update number i into the adaptor
+    std::function<void(KimpanelAdaptor &, int)> step;
+    // Even steps show the panel; time them until its first paint
+    bool firstFrame = false;
+};
+
+qint64 processCpuNs() {
+    timespec ts {};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+long peakRssKb() {
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+const QStringList &syllables() {
+    static const QStringList values = {
+        QStringLiteral("n"), QStringLiteral("ni"), QStringLiteral("ni'h"),
+        QStringLiteral("ni'ha"), QStringLiteral("ni'hao"),
+    };
+    return values;
+}
+
+const QStringList &words() {
+    static const QStringList values = {
+        QStringLiteral("你好"), QStringLiteral("你"), QStringLiteral("呢"), QStringLiteral("泥"),
+        QStringLiteral("拟好"), QStringLiteral("你号"), QStringLiteral("逆"), QStringLiteral("尼"),
+        QStringLiteral("腻"), QStringLiteral("你会"), QStringLiteral("你还"), QStringLiteral("倪"),
+    };
+    return values;
+}
+
+void setTable(KimpanelAdaptor &adaptor, int seed, int count, int cursor,
+              int layout = LookupData::LayoutNotSet) {
+    const QStringList &pool = words();
+    QStringList labels;
+    QStringList texts;
+    QStringList comments;
+    for (int i = 0; i < count; ++i) {
+        labels << QString::number(i + 1);
+        texts << pool.at((seed + i) % pool.size());
+        comments << QString();
+    }
+    adaptor.SetLookupTable(labels, texts, comments, seed > 0, true, cursor, layout);
+}
+
+QVector<Scenario> scenarios(const BusTraceReader *trace) {
+    QVector<Scenario> list = {
+        // One keystroke of pinyin input: aux, table, caret
+        {"typing", [](KimpanelAdaptor &adaptor, int i) {
+            const QStringList &input = syllables();
+            const QString &pinyin = input.at(i % input.size());
+            adaptor.setAuxText(pinyin);
+            adaptor.setAuxVisible(true);
+            setTable(adaptor, i, 5 + i % 5, 0);
+            adaptor.setLookupVisible(true);
+            adaptor.SetSpotRect(200 + (i % 40) * 12, 400, 0, 20);
+        }},
+        // Arrow keys within an unchanged page
+        {"cursor", [](KimpanelAdaptor &adaptor, int i) {
+            setTable(adaptor, 0, 9, i % 9);
+            adaptor.setLookupVisible(true);
+        }},
+        // Caret moves with the panel showing
+        {"spot", [](KimpanelAdaptor &adaptor, int i) {
+            if (i == 0) {
+                setTable(adaptor, 0, 5, 0);
+                adaptor.setLookupVisible(true);
+            }
+            adaptor.SetSpotRect(100 + (i % 80) * 9, 300 + (i / 80 % 4) * 24, 0, 20);
+        }},
+        // Tray status traffic while switching input methods
+        {"properties", [](KimpanelAdaptor &adaptor, int i) {
+            if (i == 0) {
+                adaptor.handleRegisterProperties({
+                    QStringLiteral("/Fcitx/im:拼音:fcitx-pinyin:拼音:label=拼"),
+                    QStringLiteral("/Fcitx/chttrans:简体中文:fcitx-chttrans-inactive:简体中文:menu,label=简"),
+                    QStringLiteral("/Fcitx/punctuation:全角标点:fcitx-punc-active:全角标点:label=，。"),
+                });
+            }
+            adaptor.handleUpdateProperty(i % 2
+                ? QStringLiteral("/Fcitx/im:拼音:fcitx-pinyin:拼音:label=拼")
+                : QStringLiteral("/Fcitx/im:英语:fcitx-keyboard-us:英语:label=En"));
+        }},
+        // Symbol picker: a long vertical table, cursor stepping through it
+        {"picker", [](KimpanelAdaptor &adaptor, int i) {
+            setTable(adaptor, i / 50, 300, i % 300, LookupData::LayoutVertical);
+            adaptor.setLookupVisible(true);
+        }},
+        // Type a word, commit it, repeat: the panel appears and disappears
+        // every step (compare with KIMPANEL_PERSISTENT_SURFACE=1, ideally under Xvfb)
+        {"showhide", [](KimpanelAdaptor &adaptor, int i) {
+            const bool show = i % 2 == 0;
+            if (show) {
+                setTable(adaptor, i / 2, 5, 0);
+                adaptor.setAuxText(syllables().at(i / 2 % syllables().size()));
+            }
+            adaptor.setAuxVisible(show);
+            adaptor.setLookupVisible(show);
+        }, true},
+    };
+    // A --record capture, looped; one update per recorded message
+    if (trace && trace->count() > 0) {
+        list.push_back({"replay", [trace](KimpanelAdaptor &adaptor, int i) {
+            BusReplayer::dispatch(&adaptor, trace->record(i % trace->count()));
+        }});
+    }
+    return list;
+}
+
+void settle(PanelWindow &panel) {
+    panel.scheduler()->flush();
+    QCoreApplication::processEvents();
+}
+
+qint64 percentileUs(QVector<qint64> samplesNs, double fraction) {
+    if (samplesNs.isEmpty()) {
+        return 0;
+    }
+    const qsizetype index = std::min<qsizetype>(samplesNs.size() - 1, qsizetype(fraction * samplesNs.size()));
+    std::nth_element(samplesNs.begin(), samplesNs.begin() + index, samplesNs.end());
+    return samplesNs.at(index) / 1000;
+}
+
+void run(const Scenario &scenario, int iterations) {
+    KimpanelAdaptor adaptor;
+    PanelWindow panel(&adaptor);
+    panel.hide();
+    // Idle-time glyph warming would otherwise run inside the measured updates
+    while (panel.isPrewarming()) {
+        QCoreApplication::processEvents();
+    }
+
+    for (int i = 0; i < WARMUP_ITERATIONS; ++i) {
+        scenario.step(adaptor, i);
+        settle(panel);
+    }
+
+    const PanelWindow::SizingStats sizingBefore = panel.sizingStats();
+    const PanelWindow::PositionStats positionBefore = panel.positionStats();
+    const PanelWindow::RepaintStats repaintBefore = panel.repaintStats();
+    const StaticTextCache::Stats cacheBefore = StaticTextCache::instance().stats();
+    // Only the adaptor slot and the commit are counted; building each step's
+    // QStringLists in the harness would otherwise dominate the figure
+    const quint64 lookupAllocationsBefore = adaptor.lookupAllocations();
+    const quint64 commitAllocationsBefore = panel.scheduler()->stats().commitAllocations;
+    const qint64 cpuBefore = processCpuNs();
+    QVector<qint64> firstFrameNs;
+    QElapsedTimer wall;
+    wall.start();
+    for (int i = 0; i < iterations; ++i) {
+        const int index = WARMUP_ITERATIONS + i;
+        const bool timed = scenario.firstFrame && index % 2 == 0;
+        const quint64 framesBefore = panel.repaintStats().frames;
+        const qint64 stepStart = wall.nsecsElapsed();
+        scenario.step(adaptor, index);
+        settle(panel);
+        // On xcb a newly mapped window paints only after the expose from the server
+        while (timed && panel.repaintStats().frames == framesBefore
+               && wall.nsecsElapsed() - stepStart < FIRST_FRAME_TIMEOUT_NS) {
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 1);
+        }
+        if (timed) {
+            firstFrameNs.push_back(wall.nsecsElapsed() - stepStart);
+        }
+    }
+    const qint64 wallNs = wall.nsecsElapsed();
+    const qint64 cpuNs = processCpuNs() - cpuBefore;
+    const quint64 lookupAllocations = adaptor.lookupAllocations() - lookupAllocationsBefore;
+    const quint64 commitAllocations = panel.scheduler()->stats().commitAllocations - commitAllocationsBefore;
+    const StaticTextCache::Stats cacheAfter = StaticTextCache::instance().stats();
+    const quint64 cacheHits = cacheAfter.hits - cacheBefore.hits;
+    const quint64 cacheLookups = cacheHits + cacheAfter.misses - cacheBefore.misses;
+
+    QTextStream out(stdout);
+    out << "{\"bench\":\"panel\",\"scenario\":\"" << scenario.name
+        << "\",\"renderer\":\"" << (CandidateStrip::isRequested() ? "strip" : "chips")
+        << "\",\"platform\":\"" << QGuiApplication::platformName()
+        << "\",\"updates\":" << iterations
+        << ",\"updates_per_sec\":" << QString::number(iterations * 1e9 / std::max<qint64>(wallNs, 1), 'f', 1)
+        << ",\"cpu_ns_per_update\":" << QString::number(double(cpuNs) / iterations, 'f', 1)
+        << ",\"allocs_per_update\":" << QString::number(double(lookupAllocations + commitAllocations) / iterations, 'f', 2)
+        << ",\"lookup_allocs_per_update\":" << QString::number(double(lookupAllocations) / iterations, 'f', 2)
+        << ",\"commit_allocs_per_update\":" << QString::number(double(commitAllocations) / iterations, 'f', 2)
+        << ",\"text_cache_hit_rate\":" << QString::number(cacheLookups ? double(cacheHits) / cacheLookups : 0.0, 'f', 3)
+        << ",\"repainted_px_per_update\":"
+        << QString::number(double(panel.repaintStats().pixels - repaintBefore.pixels) / iterations, 'f', 0)
+        << ",\"window_px\":" << qRound64(panel.width() * panel.height() * panel.devicePixelRatioF() * panel.devicePixelRatioF())
+        << ",\"window_moves\":" << panel.positionStats().moves - positionBefore.moves
+        << ",\"window_resizes\":" << panel.sizingStats().resizes - sizingBefore.resizes
+        << ",\"resizes_avoided\":" << panel.sizingStats().resizesAvoided - sizingBefore.resizesAvoided
+        << ",\"persistent_surface\":" << (PanelWindow::persistentSurfaceRequested() ? "true" : "false");
+    if (scenario.firstFrame) {
+        out << ",\"first_frame_us_p50\":" << percentileUs(firstFrameNs, 0.5)
+            << ",\"first_frame_us_p99\":" << percentileUs(firstFrameNs, 0.99);
+    }
+    out << ",\"peak_rss_kb\":" << peakRssKb() << "}\n";
+}
+}
+
+int main(int argc, char *argv[]) {
+    // Headless by default; QT_QPA_PLATFORM=xcb runs it against Xvfb instead
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    DApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("kimpanel-bench"));
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption iterationsOption(QStringList{QStringLiteral("n"), QStringLiteral("iterations")},
+                                              QStringLiteral("Measured updates per scenario."),
+                                              QStringLiteral("count"),
+                                              QString::number(DEFAULT_ITERATIONS));
+    const QCommandLineOption replayOption(QStringLiteral("replay"),
+                                          QStringLiteral("Add a replay scenario looping over a kimpanel-lite --record capture."),
+                                          QStringLiteral("file"));
+    parser.addOption(iterationsOption);
+    parser.addOption(replayOption);
+    parser.addPositionalArgument(QStringLiteral("scenario"),
+                                 QStringLiteral("typing, cursor, spot, properties, picker, showhide or replay; all when omitted."));
+    parser.process(app);
+
+    BusTraceReader trace;
+    if (parser.isSet(replayOption) && !trace.open(parser.value(replayOption))) {
+        qCritical() << "Cannot read" << parser.value(replayOption) << trace.errorString();
+        return 1;
+    }
+
+    const int iterations = std::max(1, parser.value(iterationsOption).toInt());
+    const QStringList selected = parser.positionalArguments();
+    for (const Scenario &scenario : scenarios(parser.isSet(replayOption) ? &trace : nullptr)) {
+        if (selected.isEmpty() || selected.contains(QLatin1String(scenario.name))) {
+            run(scenario, iterations);
+        }
+    }
+    return 0;
+}
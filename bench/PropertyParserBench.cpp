@@ -0,0 +1,107 @@
+// Compares the QStringView property parser against the split()/join() based
+// implementation it replaced. Prints one JSON object per case.
+
+#include "PropertyParser.h"
+
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTextStream>
+
+#include <functional>
+
+namespace {
+constexpr int ITERATIONS = 200000;
+
+// Previous KimpanelAdaptor::parsePropertyString
+PanelProperty legacyParseProperty(const QString &raw) {
+    PanelProperty prop;
+    if (raw.isEmpty()) {
+        return prop;
+    }
+    const QStringList parts = raw.split(QLatin1Char(':'), Qt::KeepEmptyParts);
+    if (parts.size() < 4) {
+        return prop;
+    }
+    prop.key = parts.value(0);
+    prop.label = parts.value(1);
+    prop.icon = parts.value(2);
+    prop.tip = parts.value(3);
+    if (parts.size() > 4) {
+        prop.hint = parts.mid(4).join(QLatin1Char(':'));
+    }
+    return prop;
+}
+
+// Previous SystemTrayController::extractHintValue
+QString legacyExtractHintValue(const QString &hint, const QString &key) {
+    if (hint.isEmpty() || key.isEmpty()) {
+        return {};
+    }
+    const QString search = key + QLatin1Char('=');
+    const QStringList parts = hint.split(QLatin1Char(','), Qt::SkipEmptyParts);
+    for (const QString &part : parts) {
+        const QString trimmed = part.trimmed();
+        if (trimmed.startsWith(search)) {
+            return trimmed.mid(search.size());
+        }
+    }
+    return {};
+}
+
+const QStringList &sampleProperties() {
+    static const QStringList samples = {
+        QStringLiteral("/Fcitx/im:拼音:fcitx-pinyin:拼音:label=拼"),
+        QStringLiteral("/Fcitx/chttrans:简体中文:fcitx-chttrans-inactive:简体中文:menu, label=简"),
+        QStringLiteral("/Fcitx/punctuation:全角标点:fcitx-punc-active:全角标点:label=，。"),
+        QStringLiteral("/Fcitx/fullwidth:半角:fcitx-fullwidth-inactive:半角:label=半"),
+        QStringLiteral("/Fcitx/clipboard:Clipboard:edit-paste:Clipboard"),
+        QStringLiteral("/Fcitx/logo:Fcitx:fcitx:Fcitx:menu"),
+    };
+    return samples;
+}
+
+void report(const char *bench, const char *impl, qint64 elapsedNs, qsizetype sink) {
+    QTextStream out(stdout);
+    out << "{\"bench\":\"" << bench << "\",\"impl\":\"" << impl
+        << "\",\"iterations\":" << ITERATIONS
+        << ",\"ns_per_op\":" << QString::number(double(elapsedNs) / ITERATIONS, 'f', 1)
+        << ",\"sink\":" << sink << "}\n";
+}
+
+void run(const char *bench, const char *impl, const std::function<qsizetype(const QString &)> &op) {
+    const QStringList &samples = sampleProperties();
+    qsizetype sink = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        sink += op(samples.at(i % samples.size()));
+    }
+    report(bench, impl, timer.nsecsElapsed(), sink);
+}
+}
+
+int main() {
+    run("parse-property", "legacy", [](const QString &raw) {
+        return legacyParseProperty(raw).hint.size();
+    });
+    run("parse-property", "stringview", [](const QString &raw) {
+        return PropertyParser::parseProperty(raw).hint.size();
+    });
+
+    // Tray refresh: the legacy path re-split the hint on every lookup
+    QVector<PanelProperty> parsed;
+    for (const QString &raw : sampleProperties()) {
+        parsed.push_back(PropertyParser::parseProperty(raw));
+    }
+    int next = 0;
+    run("hint-lookup", "legacy", [&](const QString &) {
+        const auto &prop = parsed.at(next++ % parsed.size());
+        return legacyExtractHintValue(prop.hint, QStringLiteral("label")).size();
+    });
+    next = 0;
+    run("hint-lookup", "pre-parsed", [&](const QString &) {
+        const auto &prop = parsed.at(next++ % parsed.size());
+        return prop.hints.value(u"label").size();
+    });
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include "AllocationCounter.h"
+
+#ifdef KIMPANEL_ALLOC_STATS
+
+#include <atomic>
+#include <cstddef>
+
+// Qt containers allocate through malloc directly, so counting operator new
+// alone would miss QString and QList storage. Interpose the glibc allocator
+// entry points instead; operator new ends up here as well.
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *ptr, std::size_t size);
+}
+
+namespace {
+constinit std::atomic<quint64> allocationCount{0};
+}
+
+extern "C" {
+void *malloc(std::size_t size) noexcept {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t count, std::size_t size) noexcept {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, std::size_t size) noexcept {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+}
+
+quint64 AllocationCounter::allocations() {
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QtGlobal>
+
+// Process-wide heap allocation counter used to profile update paths.
+// Counting is only compiled in with -DKIMPANEL_ALLOC_STATS=ON; otherwise the
+// counter always reads zero and costs nothing.
+namespace AllocationCounter {
+#ifdef KIMPANEL_ALLOC_STATS
+constexpr bool enabled = true;
+quint64 allocations();
+#else
+constexpr bool enabled = false;
+inline quint64 allocations() { return 0; }
+#endif
+}
+
+// Counts allocations made between construction and count()
+class AllocationScope {
+public:
+    AllocationScope() : start_(AllocationCounter::allocations()) {}
+    quint64 count() const { return AllocationCounter::allocations() - start_; }
+
+private:
+    quint64 start_;
+};
@@ -0,0 +1,273 @@
+#include "AttributedTextView.h"
+
+#include <QEvent>
+#include <QFontMetrics>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QTextBoundaryFinder>
+#include <QTextCharFormat>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Characters per independently laid out segment, before moving the cut to a boundary
+constexpr qsizetype SEGMENT_LENGTH = 8;
+// A single word longer than this is cut at a grapheme boundary instead
+constexpr qsizetype MAX_SEGMENT_LENGTH = 4 * SEGMENT_LENGTH;
+constexpr int CARET_WIDTH = 1;
+
+qsizetype firstDifference(QStringView a, QStringView b) {
+    const qsizetype limit = std::min(a.size(), b.size());
+    qsizetype i = 0;
+    while (i < limit && a.at(i) == b.at(i)) {
+        ++i;
+    }
+    // Never split a surrogate pair between an old and a new segment
+    if (i > 0 && i < a.size() && a.at(i - 1).isHighSurrogate()) {
+        --i;
+    }
+    return i;
+}
+
+qsizetype firstAttributeDifference(const QVector<TextAttribute> &a, const QVector<TextAttribute> &b) {
+    int first = -1;
+    auto consider = [&first](const QVector<TextAttribute> &from, const QVector<TextAttribute> &other) {
+        for (const auto &attribute : from) {
+            if (!other.contains(attribute) && (first < 0 || attribute.start < first)) {
+                first = attribute.start;
+            }
+        }
+    };
+    consider(a, b);
+    consider(b, a);
+    return first;
+}
+
+// Offset of the first boundary at or after position, or the end of the text
+qsizetype boundaryFrom(QTextBoundaryFinder &finder, qsizetype position, qsizetype size) {
+    if (position >= size) {
+        return size;
+    }
+    finder.setPosition(position);
+    if (finder.isAtBoundary()) {
+        return position;
+    }
+    const qsizetype next = finder.toNextBoundary();
+    return next < 0 ? size : next;
+}
+}
+
+AttributedTextView::AttributedTextView(QWidget *parent)
+    : QWidget(parent) {
+    setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+}
+
+void AttributedTextView::setContent(const QString &text, const QVector<TextAttribute> &attributes, int caret) {
+    qsizetype dirtyFrom = firstDifference(text_, text);
+    if (text.size() == text_.size() && dirtyFrom == text.size()) {
+        dirtyFrom = -1;
+    }
+
+    if (attributes != attributes_) {
+        const qsizetype attributeFrom = utf16Offset(text, firstAttributeDifference(attributes_, attributes));
+        dirtyFrom = dirtyFrom < 0 ? attributeFrom : std::min(dirtyFrom, attributeFrom);
+        attributes_ = attributes;
+    }
+
+    const qsizetype newCaret = caret < 0 ? -1 : utf16Offset(text, caret);
+    const bool caretMoved = newCaret != caret_;
+    const QRect oldCaret = caretRect();
+
+    if (dirtyFrom >= 0) {
+        const int oldWidth = contentWidth();
+        text_ = text;
+        rebuildFormats();
+        relayoutFrom(dirtyFrom);
+        caret_ = newCaret;
+
+        if (contentWidth() != oldWidth) {
+            updateGeometry();
+        }
+        // Repaint from the first re-laid out segment to the end of the old or new text
+        qreal dirtyX = 0;
+        for (const auto &segment : segments_) {
+            if (segment.start + segment.length >= dirtyFrom) {
+                dirtyX = segment.x;
+                break;
+            }
+            dirtyX = segment.x + segment.width;
+        }
+        const int left = static_cast<int>(std::floor(dirtyX));
+        update(QRect(left, 0, std::max(oldWidth, contentWidth()) - left + CARET_WIDTH, height()));
+    } else {
+        caret_ = newCaret;
+    }
+
+    if (caretMoved) {
+        update(oldCaret);
+        update(caretRect());
+    }
+}
+
+QSize AttributedTextView::sizeHint() const {
+    return QSize(contentWidth() + CARET_WIDTH, fontMetrics().height());
+}
+
+QSize AttributedTextView::minimumSizeHint() const {
+    return sizeHint();
+}
+
+void AttributedTextView::paintEvent(QPaintEvent *event) {
+    QPainter painter(this);
+    painter.setPen(palette().color(foregroundRole()));
+
+    const QRect dirty = event->rect();
+    for (const auto &segment : segments_) {
+        if (segment.x > dirty.right() || segment.x + segment.width < dirty.left()) {
+            continue;
+        }
+        segment.layout->draw(&painter, QPointF(segment.x, 0));
+    }
+
+    if (caret_ >= 0) {
+        painter.fillRect(caretRect(), palette().color(foregroundRole()));
+    }
+}
+
+void AttributedTextView::changeEvent(QEvent *event) {
+    QWidget::changeEvent(event);
+    const QEvent::Type type = event->type();
+    if (type == QEvent::FontChange || type == QEvent::PaletteChange) {
+        rebuildFormats();
+        relayoutFrom(0);
+        updateGeometry();
+        update();
+    }
+}
+
+void AttributedTextView::rebuildFormats() {
+    formats_.clear();
+    formats_.reserve(attributes_.size());
+    for (const auto &attribute : std::as_const(attributes_)) {
+        QTextLayout::FormatRange range;
+        range.start = static_cast<int>(utf16Offset(text_, attribute.start));
+        range.length = static_cast<int>(utf16Offset(text_, attribute.start + attribute.length)) - range.start;
+        if (range.length <= 0) {
+            continue;
+        }
+        switch (attribute.type) {
+        case TextAttribute::Decorate:
+            if (attribute.value == TextAttribute::Underline) {
+                range.format.setFontUnderline(true);
+            } else if (attribute.value == TextAttribute::Highlight) {
+                range.format.setBackground(palette().color(QPalette::Highlight));
+                range.format.setForeground(palette().color(QPalette::HighlightedText));
+            } else if (attribute.value == TextAttribute::Reverse) {
+                range.format.setBackground(palette().color(foregroundRole()));
+                range.format.setForeground(palette().color(QPalette::Window));
+            }
+            break;
+        case TextAttribute::Foreground:
+            range.format.setForeground(QColor::fromRgb(static_cast<QRgb>(attribute.value) | 0xff000000u));
+            break;
+        case TextAttribute::Background:
+            range.format.setBackground(QColor::fromRgb(static_cast<QRgb>(attribute.value) | 0xff000000u));
+            break;
+        case TextAttribute::None:
+            continue;
+        }
+        formats_.push_back(range);
+    }
+}
+
+void AttributedTextView::relayoutFrom(qsizetype position) {
+    // Keep the segments that end before the first changed character. One ending
+    // right at it goes too: a combining mark or joiner typed there extends its
+    // last cluster, and the word it ends may run on.
+    auto keep = std::find_if(segments_.begin(), segments_.end(), [position](const Segment &segment) {
+        return segment.start + segment.length >= position;
+    });
+    segments_.erase(keep, segments_.end());
+
+    qsizetype start = segments_.empty() ? 0 : segments_.back().start + segments_.back().length;
+    qreal x = segments_.empty() ? 0 : segments_.back().x + segments_.back().width;
+    // Cuts fall on word boundaries so shaping, kerning and bidi never span two
+    // layouts, and at worst on grapheme boundaries so clusters stay whole. Only
+    // the re-laid out tail is analysed; start is already a boundary.
+    const QStringView tail = QStringView(text_).mid(start);
+    QTextBoundaryFinder words(QTextBoundaryFinder::Word, tail);
+    QTextBoundaryFinder graphemes(QTextBoundaryFinder::Grapheme, tail);
+    qsizetype offset = 0;
+    while (offset < tail.size()) {
+        qsizetype end = boundaryFrom(words, offset + SEGMENT_LENGTH, tail.size());
+        if (end - offset > MAX_SEGMENT_LENGTH) {
+            end = boundaryFrom(graphemes, offset + SEGMENT_LENGTH, tail.size());
+        }
+        const qsizetype length = end - offset;
+        offset = end;
+        Segment segment;
+        segment.start = start;
+        segment.length = length;
+        segment.x = x;
+        layoutSegment(segment);
+        x += segment.width;
+        start += length;
+        segments_.push_back(std::move(segment));
+    }
+}
+
+void AttributedTextView::layoutSegment(Segment &segment) {
+    ++segmentLayouts_;
+    segment.layout = std::make_unique<QTextLayout>(text_.mid(segment.start, segment.length), font());
+
+    QTextOption option;
+    option.setWrapMode(QTextOption::NoWrap);
+    segment.layout->setTextOption(option);
+
+    QVector<QTextLayout::FormatRange> local;
+    const qsizetype end = segment.start + segment.length;
+    for (const auto &range : std::as_const(formats_)) {
+        const qsizetype from = std::max<qsizetype>(range.start, segment.start);
+        const qsizetype to = std::min<qsizetype>(range.start + range.length, end);
+        if (from >= to) {
+            continue;
+        }
+        QTextLayout::FormatRange clipped = range;
+        clipped.start = static_cast<int>(from - segment.start);
+        clipped.length = static_cast<int>(to - from);
+        local.push_back(clipped);
+    }
+    segment.layout->setFormats(local);
+
+    segment.layout->beginLayout();
+    QTextLine line = segment.layout->createLine();
+    if (line.isValid()) {
+        line.setPosition(QPointF(0, 0));
+    }
+    segment.layout->endLayout();
+    segment.width = line.isValid() ? line.horizontalAdvance() : 0;
+}
+
+qreal AttributedTextView::caretX() const {
+    for (const auto &segment : segments_) {
+        if (caret_ < segment.start + segment.length) {
+            return segment.x + segment.layout->lineAt(0).cursorToX(static_cast<int>(caret_ - segment.start));
+        }
+    }
+    return segments_.empty() ? 0 : segments_.back().x + segments_.back().width;
+}
+
+QRect AttributedTextView::caretRect() const {
+    if (caret_ < 0) {
+        return {};
+    }
+    return QRect(static_cast<int>(std::floor(caretX())), 0, CARET_WIDTH, height());
+}
+
+int AttributedTextView::contentWidth() const {
+    if (segments_.empty()) {
+        return 0;
+    }
+    return static_cast<int>(std::ceil(segments_.back().x + segments_.back().width));
+}
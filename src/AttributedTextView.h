@@ -0,0 +1,56 @@
+#pragma once
+
+#include "TextAttribute.h"
+
+#include <QTextLayout>
+#include <QWidget>
+
+#include <memory>
+#include <vector>
+
+// Single-line text view for preedit and aux strings. The text is laid out in
+// short independent segments: an edit only re-lays out the segments from the
+// first changed character on, so appending to a long pinyin string costs
+// O(delta). Attributes are converted to format ranges once per change.
+class AttributedTextView : public QWidget {
+    Q_OBJECT
+public:
+    explicit AttributedTextView(QWidget *parent = nullptr);
+
+    // caret is a code point offset; a negative caret hides it
+    void setContent(const QString &text, const QVector<TextAttribute> &attributes, int caret = -1);
+    const QString &text() const { return text_; }
+
+    // Number of segments laid out since construction; for profiling
+    quint64 segmentLayouts() const { return segmentLayouts_; }
+
+    QSize sizeHint() const override;
+    QSize minimumSizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void changeEvent(QEvent *event) override;
+
+private:
+    struct Segment {
+        qsizetype start = 0;
+        qsizetype length = 0;
+        qreal x = 0;
+        qreal width = 0;
+        std::unique_ptr<QTextLayout> layout;
+    };
+
+    void rebuildFormats();
+    void relayoutFrom(qsizetype position);
+    void layoutSegment(Segment &segment);
+    qreal caretX() const;
+    QRect caretRect() const;
+    int contentWidth() const;
+
+    QString text_;
+    QVector<TextAttribute> attributes_;
+    QVector<QTextLayout::FormatRange> formats_;
+    qsizetype caret_ = -1;
+    std::vector<Segment> segments_;
+    quint64 segmentLayouts_ = 0;
+};
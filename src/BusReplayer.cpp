@@ -0,0 +1,143 @@
+#include "BusReplayer.h"
+
+#include "KimpanelAdaptor.h"
+
+#include <QDebug>
+#include <QStringList>
+
+#include <initializer_list>
+
+namespace {
+// Work done per event loop turn in fast mode, so the panel still gets to paint
+constexpr qint64 FAST_SLICE_NS = 2 * 1000 * 1000;
+
+bool hasTypes(const QVariantList &arguments, std::initializer_list<QMetaType::Type> types) {
+    if (arguments.size() != qsizetype(types.size())) {
+        return false;
+    }
+    qsizetype i = 0;
+    for (const QMetaType::Type type : types) {
+        if (arguments.at(i++).metaType().id() != type) {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+BusReplayer::BusReplayer(KimpanelAdaptor *adaptor, QObject *parent)
+    : QObject(parent), adaptor_(adaptor) {
+    timer_.setSingleShot(true);
+    timer_.setTimerType(Qt::PreciseTimer);
+    connect(&timer_, &QTimer::timeout, this, &BusReplayer::step);
+}
+
+bool BusReplayer::open(const QString &path) {
+    return reader_.open(path);
+}
+
+void BusReplayer::start(Pace pace) {
+    pace_ = pace;
+    next_ = 0;
+    hasPending_ = false;
+    stats_ = Stats();
+    firstTimestampNs_ = reader_.count() > 0 ? reader_.record(0).timestampNs : 0;
+    clock_.start();
+    timer_.start(0);
+}
+
+void BusReplayer::step() {
+    QElapsedTimer slice;
+    slice.start();
+
+    while (hasPending_ || next_ < reader_.count()) {
+        if (!hasPending_) {
+            pending_ = reader_.record(next_++);
+            hasPending_ = true;
+        }
+        if (pace_ == OriginalPace) {
+            const qint64 dueMs = (pending_.timestampNs - firstTimestampNs_) / 1000000;
+            const qint64 waitMs = dueMs - clock_.elapsed();
+            if (waitMs > 0) {
+                timer_.start(int(waitMs));
+                return;
+            }
+        } else if (slice.nsecsElapsed() >= FAST_SLICE_NS) {
+            timer_.start(0);
+            return;
+        }
+
+        hasPending_ = false;
+        if (dispatch(adaptor_, pending_)) {
+            ++stats_.dispatched;
+        } else {
+            ++stats_.skipped;
+        }
+    }
+
+    stats_.elapsedMs = clock_.elapsed();
+    qInfo() << "[Replay] Dispatched" << stats_.dispatched << "messages in" << stats_.elapsedMs
+            << "ms," << stats_.skipped << "skipped";
+    emit finished();
+}
+
+bool BusReplayer::dispatch(KimpanelAdaptor *adaptor, const BusTrace::Record &record) {
+    if (!adaptor) {
+        return false;
+    }
+    const QVariantList &args = record.arguments;
+    const QString &member = record.member;
+    constexpr auto Bool = QMetaType::Bool;
+    constexpr auto Int = QMetaType::Int;
+    constexpr auto String = QMetaType::QString;
+    constexpr auto List = QMetaType::QStringList;
+
+    if (record.source == BusTrace::Source::PanelCall) {
+        if (member == u"SetSpotRect" && hasTypes(args, {Int, Int, Int, Int})) {
+            adaptor->SetSpotRect(args[0].toInt(), args[1].toInt(), args[2].toInt(), args[3].toInt());
+            return true;
+        }
+        if (member == u"SetLookupTable" && hasTypes(args, {List, List, List, Bool, Bool, Int, Int})) {
+            adaptor->SetLookupTable(args[0].toStringList(), args[1].toStringList(), args[2].toStringList(),
+                                    args[3].toBool(), args[4].toBool(), args[5].toInt(), args[6].toInt());
+            return true;
+        }
+        return false;
+    }
+
+    // Mirrors KimpanelInputmethodWatcher's slots
+    if (member == u"ShowAux" && hasTypes(args, {Bool})) {
+        adaptor->setAuxVisible(args[0].toBool());
+    } else if (member == u"ShowLookupTable" && hasTypes(args, {Bool})) {
+        adaptor->setLookupVisible(args[0].toBool());
+    } else if (member == u"Enable" && hasTypes(args, {Bool})) {
+        adaptor->setEnabled(args[0].toBool());
+    } else if (member == u"ShowPreedit" && hasTypes(args, {Bool})) {
+        adaptor->setPreeditVisible(args[0].toBool());
+    } else if (member == u"UpdateAux" && hasTypes(args, {String, String})) {
+        adaptor->setAuxText(args[0].toString());
+        adaptor->setAuxAttributes(args[1].toString());
+    } else if (member == u"UpdatePreeditText" && hasTypes(args, {String, String})) {
+        adaptor->setPreeditText(args[0].toString(), args[1].toString());
+    } else if (member == u"UpdatePreeditCaret" && hasTypes(args, {Int})) {
+        adaptor->setPreeditCaret(args[0].toInt());
+    } else if (member == u"UpdateSpotLocation" && hasTypes(args, {Int, Int})) {
+        adaptor->SetSpotRect(args[0].toInt(), args[1].toInt(), 0, 0);
+    } else if (member == u"UpdateLookupTable" && hasTypes(args, {List, List, List, Bool, Bool})) {
+        adaptor->SetLookupTable(args[0].toStringList(), args[1].toStringList(), QStringList(),
+                                args[3].toBool(), args[4].toBool(), adaptor->cursor(), adaptor->layout());
+    } else if (member == u"UpdateLookupTableCursor" && hasTypes(args, {Int})) {
+        adaptor->setLookupCursor(args[0].toInt());
+    } else if (member == u"RegisterProperties" && hasTypes(args, {List})) {
+        adaptor->handleRegisterProperties(args[0].toStringList());
+    } else if (member == u"UpdateProperty" && hasTypes(args, {String})) {
+        adaptor->handleUpdateProperty(args[0].toString());
+    } else if (member == u"RemoveProperty" && hasTypes(args, {String})) {
+        adaptor->handleRemoveProperty(args[0].toString());
+    } else if (member == u"ExecMenu" && hasTypes(args, {List})) {
+        adaptor->handleExecMenu(args[0].toStringList());
+    } else {
+        return false;
+    }
+    return true;
+}
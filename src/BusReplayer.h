@@ -0,0 +1,56 @@
+#pragma once
+
+#include "BusTrace.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+class KimpanelAdaptor;
+
+// Streams a BusTrace capture back into the adaptor, either at the recorded
+// pace or as fast as the event loop allows.
+class BusReplayer : public QObject {
+    Q_OBJECT
+public:
+    enum Pace {
+        OriginalPace,
+        AsFastAsPossible,
+    };
+
+    struct Stats {
+        quint64 dispatched = 0;
+        quint64 skipped = 0;
+        qint64 elapsedMs = 0;
+    };
+
+    explicit BusReplayer(KimpanelAdaptor *adaptor, QObject *parent = nullptr);
+
+    bool open(const QString &path);
+    QString errorString() const { return reader_.errorString(); }
+    const BusTraceReader &reader() const { return reader_; }
+
+    void start(Pace pace);
+    const Stats &stats() const { return stats_; }
+
+    // Applies one record the way the panel service or inputmethod watcher would;
+    // false for members or signatures the panel does not handle
+    static bool dispatch(KimpanelAdaptor *adaptor, const BusTrace::Record &record);
+
+signals:
+    void finished();
+
+private:
+    void step();
+
+    KimpanelAdaptor *adaptor_ = nullptr;
+    BusTraceReader reader_;
+    QTimer timer_;
+    QElapsedTimer clock_;
+    Pace pace_ = OriginalPace;
+    qsizetype next_ = 0;
+    qint64 firstTimestampNs_ = 0;
+    BusTrace::Record pending_;
+    bool hasPending_ = false;
+    Stats stats_;
+};
@@ -0,0 +1,250 @@
+#include "BusTrace.h"
+
+#include "LatencyTracker.h"
+
+#include <QDBusMessage>
+#include <QDebug>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace {
+constexpr char MAGIC[4] = {'K', 'P', 'B', 'T'};
+constexpr quint32 VERSION = 1;
+constexpr qint64 HEADER_SIZE = 8;
+// Written out once this much is buffered, and on stop()
+constexpr qsizetype FLUSH_THRESHOLD = 64 * 1024;
+
+enum Tag : quint8 {
+    TagBool = 0,
+    TagInt = 1,
+    TagString = 2,
+    TagStringList = 3,
+};
+
+template <typename T>
+void put(QByteArray &out, T value) {
+    char bytes[sizeof(T)];
+    qToLittleEndian(value, bytes);
+    out.append(bytes, sizeof(T));
+}
+
+void putString(QByteArray &out, const QString &value) {
+    const QByteArray utf8 = value.toUtf8();
+    put<quint32>(out, quint32(utf8.size()));
+    out.append(utf8);
+}
+
+bool putArgument(QByteArray &out, const QVariant &value) {
+    switch (value.metaType().id()) {
+    case QMetaType::Bool:
+        put<quint8>(out, TagBool);
+        put<quint8>(out, value.toBool() ? 1 : 0);
+        return true;
+    case QMetaType::Int:
+    case QMetaType::UInt:
+        put<quint8>(out, TagInt);
+        put<qint32>(out, value.toInt());
+        return true;
+    case QMetaType::QString:
+        put<quint8>(out, TagString);
+        putString(out, value.toString());
+        return true;
+    case QMetaType::QStringList: {
+        const QStringList list = value.toStringList();
+        put<quint8>(out, TagStringList);
+        put<quint32>(out, quint32(list.size()));
+        for (const QString &item : list) {
+            putString(out, item);
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// Bounds-checked decoding over the mapped bytes
+struct Cursor {
+    const uchar *data;
+    qint64 end;
+    qint64 pos;
+    bool ok = true;
+
+    template <typename T>
+    T take() {
+        if (!ok || end - pos < qint64(sizeof(T))) {
+            ok = false;
+            return T();
+        }
+        const T value = qFromLittleEndian<T>(data + pos);
+        pos += sizeof(T);
+        return value;
+    }
+
+    QString takeString() {
+        const quint32 length = take<quint32>();
+        if (!ok || end - pos < qint64(length)) {
+            ok = false;
+            return {};
+        }
+        const QString value = QString::fromUtf8(reinterpret_cast<const char *>(data + pos), length);
+        pos += length;
+        return value;
+    }
+
+    QVariant takeArgument() {
+        switch (take<quint8>()) {
+        case TagBool:
+            return take<quint8>() != 0;
+        case TagInt:
+            return take<qint32>();
+        case TagString:
+            return takeString();
+        case TagStringList: {
+            const quint32 count = take<quint32>();
+            QStringList list;
+            for (quint32 i = 0; ok && i < count; ++i) {
+                list << takeString();
+            }
+            return list;
+        }
+        default:
+            ok = false;
+            return {};
+        }
+    }
+};
+}
+
+std::atomic<BusTraceRecorder *> BusTraceRecorder::active_{nullptr};
+
+bool BusTraceRecorder::start(const QString &path) {
+    static BusTraceRecorder recorder;
+    QMutexLocker locker(&recorder.mutex_);
+    if (recorder.file_.isOpen()) {
+        return false;
+    }
+    recorder.file_.setFileName(path);
+    if (!recorder.file_.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "[Record] Cannot open" << path << recorder.file_.errorString();
+        return false;
+    }
+    recorder.buffer_.clear();
+    recorder.buffer_.append(MAGIC, sizeof(MAGIC));
+    put<quint32>(recorder.buffer_, VERSION);
+    recorder.startNs_ = LatencyTracker::now();
+    recorder.stats_ = Stats();
+    active_.store(&recorder, std::memory_order_release);
+    qInfo() << "[Record] Capturing panel traffic to" << path;
+    return true;
+}
+
+void BusTraceRecorder::stop() {
+    BusTraceRecorder *recorder = active_.exchange(nullptr, std::memory_order_acq_rel);
+    if (!recorder) {
+        return;
+    }
+    QMutexLocker locker(&recorder->mutex_);
+    recorder->flushLocked();
+    recorder->file_.close();
+    qInfo() << "[Record] Wrote" << recorder->stats_.recorded << "messages,"
+            << recorder->stats_.unsupported << "skipped";
+}
+
+void BusTraceRecorder::record(BusTrace::Source source, const QDBusMessage &message) {
+    const qint64 now = LatencyTracker::now();
+    const QVariantList arguments = message.arguments();
+
+    QMutexLocker locker(&mutex_);
+    // A thread may still hold the pointer after stop()
+    if (!file_.isOpen()) {
+        return;
+    }
+    const qsizetype sizeAt = buffer_.size();
+    put<quint32>(buffer_, 0);
+    put<qint64>(buffer_, now - startNs_);
+    put<quint8>(buffer_, quint8(source));
+    put<quint8>(buffer_, quint8(arguments.size()));
+    putString(buffer_, message.member());
+    for (const QVariant &argument : arguments) {
+        if (!putArgument(buffer_, argument)) {
+            buffer_.truncate(sizeAt);
+            ++stats_.unsupported;
+            return;
+        }
+    }
+    qToLittleEndian(quint32(buffer_.size() - sizeAt - sizeof(quint32)), buffer_.data() + sizeAt);
+    ++stats_.recorded;
+
+    if (buffer_.size() >= FLUSH_THRESHOLD) {
+        flushLocked();
+    }
+}
+
+BusTraceRecorder::Stats BusTraceRecorder::stats() const {
+    QMutexLocker locker(&mutex_);
+    return stats_;
+}
+
+void BusTraceRecorder::flushLocked() {
+    if (!buffer_.isEmpty()) {
+        file_.write(buffer_);
+        buffer_.clear();
+    }
+    file_.flush();
+}
+
+BusTraceReader::~BusTraceReader() {
+    if (data_) {
+        file_.unmap(const_cast<uchar *>(data_));
+    }
+}
+
+bool BusTraceReader::open(const QString &path) {
+    file_.setFileName(path);
+    if (!file_.open(QIODevice::ReadOnly)) {
+        error_ = file_.errorString();
+        return false;
+    }
+    size_ = file_.size();
+    data_ = size_ >= HEADER_SIZE ? file_.map(0, size_) : nullptr;
+    if (!data_ || std::memcmp(data_, MAGIC, sizeof(MAGIC)) != 0
+        || qFromLittleEndian<quint32>(data_ + sizeof(MAGIC)) != VERSION) {
+        error_ = QStringLiteral("not a kimpanel bus trace");
+        return false;
+    }
+
+    // A capture cut short by a crash ends in a partial record; keep what is complete
+    qint64 pos = HEADER_SIZE;
+    while (size_ - pos >= qint64(sizeof(quint32))) {
+        const quint32 length = qFromLittleEndian<quint32>(data_ + pos);
+        if (size_ - pos - qint64(sizeof(quint32)) < qint64(length)) {
+            break;
+        }
+        offsets_.push_back(pos);
+        pos += sizeof(quint32) + length;
+    }
+    return true;
+}
+
+BusTrace::Record BusTraceReader::record(qsizetype index) const {
+    BusTrace::Record record;
+    const qint64 offset = offsets_.at(index);
+    const quint32 length = qFromLittleEndian<quint32>(data_ + offset);
+    Cursor cursor{data_, offset + qint64(sizeof(quint32)) + length, offset + qint64(sizeof(quint32))};
+    record.timestampNs = cursor.take<qint64>();
+    record.source = BusTrace::Source(cursor.take<quint8>());
+    const quint8 argumentCount = cursor.take<quint8>();
+    record.member = cursor.takeString();
+    for (quint8 i = 0; cursor.ok && i < argumentCount; ++i) {
+        record.arguments << cursor.takeArgument();
+    }
+    if (!cursor.ok) {
+        record.member.clear();
+        record.arguments.clear();
+    }
+    return record;
+}
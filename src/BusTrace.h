@@ -0,0 +1,90 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <QVariantList>
+#include <QVector>
+
+#include <atomic>
+#include <memory>
+
+class QDBusMessage;
+
+// Compact binary capture of incoming panel D-Bus traffic.
+//
+// A file starts with the 4 byte magic "KPBT" and a u32 format version, followed
+// by self-delimiting records:
+//   u32 size of the rest of the record
+//   i64 nanoseconds since the capture started
+//   u8  source, u8 argument count, str member
+//   per argument: u8 type tag, then u8 (bool), i32 (int), str (string) or
+//                 u32 count + that many str (string list)
+// where str is a u32 byte length followed by UTF-8. Integers are little endian,
+// so a mapped file can be indexed and decoded in place.
+namespace BusTrace {
+enum class Source : quint8 {
+    // org.kde.impanel2 method call on the panel object
+    PanelCall = 0,
+    // org.kde.kimpanel.inputmethod signal from the engine
+    InputmethodSignal = 1,
+};
+
+struct Record {
+    qint64 timestampNs = 0;
+    Source source = Source::PanelCall;
+    QString member;
+    QVariantList arguments;
+};
+}
+
+// Appends incoming messages to a trace file. Started once from main with
+// --record; record() may be called from the GUI and the D-Bus I/O thread.
+class BusTraceRecorder {
+public:
+    struct Stats {
+        quint64 recorded = 0;
+        // Messages carrying argument types the format has no tag for
+        quint64 unsupported = 0;
+    };
+
+    // The running recorder, or nullptr; checking it is the only cost when not capturing
+    static BusTraceRecorder *active() { return active_.load(std::memory_order_acquire); }
+    static bool start(const QString &path);
+    static void stop();
+
+    void record(BusTrace::Source source, const QDBusMessage &message);
+    Stats stats() const;
+
+private:
+    BusTraceRecorder() = default;
+    void flushLocked();
+
+    static std::atomic<BusTraceRecorder *> active_;
+
+    mutable QMutex mutex_;
+    QFile file_;
+    QByteArray buffer_;
+    qint64 startNs_ = 0;
+    Stats stats_;
+};
+
+// Read-only view of a trace file; records are decoded from the mapping on demand
+class BusTraceReader {
+public:
+    ~BusTraceReader();
+
+    bool open(const QString &path);
+    QString errorString() const { return error_; }
+
+    qsizetype count() const { return offsets_.size(); }
+    BusTrace::Record record(qsizetype index) const;
+
+private:
+    QFile file_;
+    const uchar *data_ = nullptr;
+    qint64 size_ = 0;
+    QVector<qint64> offsets_;
+    QString error_;
+};
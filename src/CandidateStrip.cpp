@@ -0,0 +1,384 @@
+#include "CandidateStrip.h"
+
+#include "StaticTextCache.h"
+
+#include <QEvent>
+#include <QFontMetricsF>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QRegion>
+#include <QWheelEvent>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+// Same geometry as the CandidateChip row: chip margins, run spacing, chip spacing
+constexpr int CHIP_MARGIN = 2;
+constexpr int RUN_SPACING = 4;
+constexpr int CHIP_SPACING = 10;
+// Between the rows of a vertical list
+constexpr int ROW_SPACING = 2;
+// Scroll position bar along the window of a long table
+constexpr int INDICATOR_SIZE = 3;
+constexpr int INDICATOR_GAP = 3;
+// angleDelta() of one wheel notch
+constexpr int WHEEL_STEP = 120;
+}
+
+CandidateStrip::CandidateStrip(QWidget *parent)
+    : QWidget(parent) {
+    setObjectName("candidateStrip");
+    setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+    setTheme(PanelTheme::fromWidget(this));
+    refreshRowHeight();
+    relayout();
+}
+
+bool CandidateStrip::isRequested() {
+    return qEnvironmentVariable("KIMPANEL_CANDIDATE_RENDERER") == QLatin1String("strip");
+}
+
+void CandidateStrip::setTheme(const PanelTheme &theme) {
+    primaryColor_ = theme.text;
+    highlightColor_ = theme.highlight;
+    commentColor_ = theme.comment;
+    if (theme.labelFont != labelFont_ || theme.candidateFont != textFont_) {
+        labelFont_ = theme.labelFont;
+        textFont_ = theme.candidateFont;
+        // Entries shaped with the old theme fonts would only age out
+        StaticTextCache::instance().clear();
+        refreshRowHeight();
+        remeasureAll();
+    } else {
+        update();
+    }
+}
+
+void CandidateStrip::setVertical(bool vertical) {
+    if (vertical_ == vertical) {
+        return;
+    }
+    vertical_ = vertical;
+    relayout();
+    updateGeometry();
+    update();
+}
+
+void CandidateStrip::setCandidates(std::span<const QString> labels,
+                                   std::span<const QString> texts,
+                                   std::span<const QString> comments,
+                                   const LookupChange &change,
+                                   int cursor) {
+    const int count = static_cast<int>(texts.size());
+    const int previousCount = static_cast<int>(items_.size());
+    // Damage is worked out per candidate against the window as it was
+    std::array<QRect, VISIBLE_LIMIT> before;
+    const int beforeCount = visibleCount();
+    for (int i = 0; i < beforeCount; ++i) {
+        before[i] = candidateRect(first_ + i);
+    }
+    const QRect indicatorBefore = indicatorRect();
+    static const QString empty;
+    auto entry = [](std::span<const QString> list, int i) -> const QString & {
+        return i < static_cast<int>(list.size()) ? list[i] : empty;
+    };
+
+    items_.resize(count);
+    int firstChanged = -1;
+    int lastChanged = -1;
+    if (change.hasTextChanges()) {
+        firstChanged = std::max(change.firstChanged, 0);
+        lastChanged = std::min(change.lastChanged, count - 1);
+    }
+    // New slots are always measured, whatever the change says
+    if (count > previousCount) {
+        firstChanged = firstChanged < 0 ? previousCount : std::min(firstChanged, previousCount);
+        lastChanged = count - 1;
+    }
+    // Strings are cheap shared copies; shaping waits until an entry enters the window
+    for (int i = std::max(firstChanged, 0); firstChanged >= 0 && i <= lastChanged; ++i) {
+        Item &item = items_[i];
+        item.label = entry(labels, i);
+        item.text = texts[i];
+        item.comment = entry(comments, i);
+        item.measured = false;
+    }
+
+    const int previousCursor = cursor_;
+    const int previousFirst = first_;
+    cursor_ = cursor;
+    // Follow the engine cursor; a wheel scroll is kept until the cursor moves
+    placeWindow(cursor_ != previousCursor || count != previousCount ? cursor_ : -1);
+    const bool windowMoved = first_ != previousFirst;
+    const int windowEnd = first_ + visibleCount();
+    const bool windowChanged = firstChanged >= 0 && firstChanged < windowEnd && lastChanged >= first_;
+    if (!windowMoved && !windowChanged && count == previousCount) {
+        if (previousCursor != cursor_) {
+            update(candidateRect(previousCursor));
+            update(candidateRect(cursor_));
+        }
+        return;
+    }
+
+    const QSize oldSize(contentWidth_, contentHeight_);
+    measureWindow();
+    relayout();
+    const QSize newSize(contentWidth_, contentHeight_);
+    if (newSize != oldSize) {
+        updateGeometry();
+    }
+    // The window and the scroll indicator moved as a whole
+    if (windowMoved || (isScrollable() && count != previousCount)) {
+        update();
+        return;
+    }
+    // Entries that changed, moved or went away, in their old and new place. A
+    // same-width replacement repaints one entry; only a width change moves
+    // (and repaints) the entries after it.
+    QRegion damage;
+    for (int i = 0; i < std::max(beforeCount, visibleCount()); ++i) {
+        const int index = first_ + i;
+        const QRect old = i < beforeCount ? before[i] : QRect();
+        const QRect now = candidateRect(index);
+        if ((index >= firstChanged && index <= lastChanged) || old != now) {
+            damage += old;
+            damage += now;
+        }
+    }
+    if (previousCursor != cursor_) {
+        damage += candidateRect(previousCursor);
+        damage += candidateRect(cursor_);
+    }
+    if (isScrollable() && newSize != oldSize) {
+        damage += indicatorBefore;
+        damage += indicatorRect();
+    }
+    update(damage);
+}
+
+void CandidateStrip::scrollBy(int delta) {
+    const int previousFirst = first_;
+    first_ += delta;
+    placeWindow(-1);
+    if (first_ == previousFirst) {
+        return;
+    }
+    const QSize oldSize(contentWidth_, contentHeight_);
+    measureWindow();
+    relayout();
+    if (QSize(contentWidth_, contentHeight_) != oldSize) {
+        updateGeometry();
+    }
+    update();
+}
+
+int CandidateStrip::indexAt(const QPoint &pos) const {
+    for (int i = first_; i < first_ + visibleCount(); ++i) {
+        if (candidateRect(i).contains(pos)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QRect CandidateStrip::candidateRect(int index) const {
+    if (index < first_ || index >= first_ + visibleCount()) {
+        return {};
+    }
+    const Item &item = items_[index];
+    const int left = static_cast<int>(std::floor(item.x));
+    const int right = static_cast<int>(std::ceil(item.x + item.width));
+    return QRect(left, static_cast<int>(item.y), right - left, rowHeight_);
+}
+
+QSize CandidateStrip::sizeHint() const {
+    return QSize(contentWidth_, contentHeight_);
+}
+
+QSize CandidateStrip::minimumSizeHint() const {
+    return sizeHint();
+}
+
+void CandidateStrip::paintEvent(QPaintEvent *event) {
+    QPainter painter(this);
+    // The region, not its bounding rect: a cursor move damages two separate entries
+    const QRegion &dirty = event->region();
+    const qreal labelTop = (rowHeight_ - QFontMetricsF(labelFont_).height()) / 2;
+    const qreal textTop = (rowHeight_ - QFontMetricsF(textFont_).height()) / 2;
+
+    for (int i = first_; i < first_ + visibleCount(); ++i) {
+        const Item &item = items_[i];
+        const Runs &runs = runs_[i % VISIBLE_LIMIT];
+        if (!dirty.intersects(candidateRect(i))) {
+            continue;
+        }
+        const QColor &color = i == cursor_ ? highlightColor_ : primaryColor_;
+        qreal x = item.x + CHIP_MARGIN;
+        painter.setPen(color);
+        if (!item.label.isEmpty()) {
+            painter.setFont(labelFont_);
+            painter.drawStaticText(QPointF(x, item.y + labelTop), runs.label);
+            x += item.labelWidth + RUN_SPACING;
+        }
+        painter.setFont(textFont_);
+        painter.drawStaticText(QPointF(x, item.y + textTop), runs.text);
+        x += item.textWidth;
+        if (!item.comment.isEmpty()) {
+            x += RUN_SPACING;
+            painter.setFont(labelFont_);
+            painter.setPen(commentColor_);
+            painter.drawStaticText(QPointF(x, item.y + labelTop), runs.comment);
+        }
+    }
+
+    if (isScrollable() && dirty.intersects(indicatorRect())) {
+        // Thumb only: its span along the track is the window's share of the table
+        const QRect track = indicatorRect();
+        const int length = vertical_ ? track.height() : track.width();
+        const int thumbStart = length * first_ / count();
+        const int thumbLength = std::max(length * visibleCount() / count(), 2 * INDICATOR_SIZE);
+        const QRect thumb = vertical_
+            ? QRect(track.left(), track.top() + thumbStart, INDICATOR_SIZE, thumbLength)
+            : QRect(track.left() + thumbStart, track.top(), thumbLength, INDICATOR_SIZE);
+        painter.fillRect(thumb.intersected(track), commentColor_);
+    }
+}
+
+void CandidateStrip::changeEvent(QEvent *event) {
+    QWidget::changeEvent(event);
+    // Colours and fonts arrive through setTheme(); only the scale is tracked here
+    switch (event->type()) {
+    case QEvent::ScreenChangeInternal:
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+    case QEvent::DevicePixelRatioChange:
+#endif
+        if (devicePixelRatioF() != devicePixelRatio_) {
+            StaticTextCache::instance().clear();
+            remeasureAll();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void CandidateStrip::wheelEvent(QWheelEvent *event) {
+    if (!isScrollable()) {
+        QWidget::wheelEvent(event);
+        return;
+    }
+    const QPoint delta = event->angleDelta();
+    wheelRemainder_ += delta.y() != 0 ? delta.y() : delta.x();
+    const int steps = wheelRemainder_ / WHEEL_STEP;
+    wheelRemainder_ -= steps * WHEEL_STEP;
+    // Wheel up shows earlier entries
+    scrollBy(-steps);
+    event->accept();
+}
+
+void CandidateStrip::refreshRowHeight() {
+    rowHeight_ = static_cast<int>(std::ceil(std::max(QFontMetricsF(labelFont_).height(),
+                                                     QFontMetricsF(textFont_).height())))
+        + 2 * CHIP_MARGIN;
+}
+
+void CandidateStrip::measure(int index) {
+    Item &item = items_[index];
+    Runs &runs = runs_[index % VISIBLE_LIMIT];
+    StaticTextCache &cache = StaticTextCache::instance();
+    devicePixelRatio_ = devicePixelRatioF();
+    auto run = [&](const QString &string, const QFont &font, QStaticText &out) -> qreal {
+        if (string.isEmpty()) {
+            out = QStaticText();
+            return 0;
+        }
+        out = cache.text(string, font, devicePixelRatio_);
+        return out.size().width();
+    };
+    item.labelWidth = run(item.label, labelFont_, runs.label);
+    item.textWidth = run(item.text, textFont_, runs.text);
+    item.commentWidth = run(item.comment, labelFont_, runs.comment);
+    runs.entry = index;
+    item.width = 2 * CHIP_MARGIN + item.textWidth;
+    if (!item.label.isEmpty()) {
+        item.width += item.labelWidth + RUN_SPACING;
+    }
+    if (!item.comment.isEmpty()) {
+        item.width += item.commentWidth + RUN_SPACING;
+    }
+    item.measured = true;
+}
+
+void CandidateStrip::measureWindow() {
+    for (int i = first_; i < first_ + visibleCount(); ++i) {
+        // An entry scrolled back in finds its slot taken; the cache makes re-shaping a lookup
+        if (!items_[i].measured || runs_[i % VISIBLE_LIMIT].entry != i) {
+            measure(i);
+        }
+    }
+}
+
+void CandidateStrip::remeasureAll() {
+    for (Item &item : items_) {
+        item.measured = false;
+    }
+    measureWindow();
+    relayout();
+    updateGeometry();
+    update();
+}
+
+void CandidateStrip::relayout() {
+    qreal x = 0;
+    qreal y = 0;
+    qreal widest = 0;
+    for (int i = first_; i < first_ + visibleCount(); ++i) {
+        Item &item = items_[i];
+        if (vertical_) {
+            item.x = 0;
+            item.y = y;
+            y += rowHeight_ + ROW_SPACING;
+            widest = std::max(widest, item.width);
+        } else {
+            item.x = x;
+            item.y = 0;
+            x += item.width + CHIP_SPACING;
+        }
+    }
+    if (visibleCount() <= 0) {
+        contentWidth_ = 0;
+        contentHeight_ = rowHeight_;
+        return;
+    }
+    if (vertical_) {
+        contentWidth_ = static_cast<int>(std::ceil(widest));
+        contentHeight_ = static_cast<int>(std::ceil(y)) - ROW_SPACING;
+    } else {
+        contentWidth_ = static_cast<int>(std::ceil(x - CHIP_SPACING));
+        contentHeight_ = rowHeight_;
+    }
+    if (isScrollable() && vertical_) {
+        contentWidth_ += INDICATOR_GAP + INDICATOR_SIZE;
+    } else if (isScrollable()) {
+        contentHeight_ += INDICATOR_GAP + INDICATOR_SIZE;
+    }
+}
+
+void CandidateStrip::placeWindow(int index) {
+    if (index >= 0 && index < count()) {
+        if (index < first_) {
+            first_ = index;
+        } else if (index >= first_ + VISIBLE_LIMIT) {
+            first_ = index - VISIBLE_LIMIT + 1;
+        }
+    }
+    first_ = std::clamp(first_, 0, std::max(count() - VISIBLE_LIMIT, 0));
+}
+
+QRect CandidateStrip::indicatorRect() const {
+    return vertical_
+        ? QRect(contentWidth_ - INDICATOR_SIZE, 0, INDICATOR_SIZE, contentHeight_)
+        : QRect(0, contentHeight_ - INDICATOR_SIZE, contentWidth_, INDICATOR_SIZE);
+}
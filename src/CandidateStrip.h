@@ -0,0 +1,119 @@
+#pragma once
+
+#include "KimpanelAdaptor.h"
+#include "PanelTheme.h"
+
+#include <QColor>
+#include <QFont>
+#include <QStaticText>
+#include <QWidget>
+
+#include <algorithm>
+#include <array>
+#include <span>
+#include <vector>
+
+// Candidate row drawn by a single widget: label, text and comment runs are
+// shaped once through StaticTextCache, positioned arithmetically and painted
+// as pre-shaped glyph runs, replacing a CandidateChip (layout plus three
+// labels) per candidate. Enabled with KIMPANEL_CANDIDATE_RENDERER=strip, and
+// used for any table longer than VISIBLE_LIMIT.
+//
+// Only a window of VISIBLE_LIMIT entries is shaped, laid out and painted; it
+// follows the engine cursor and scrolls with the mouse wheel, so cost stays
+// bounded by the window whatever the table size.
+class CandidateStrip : public QWidget {
+    Q_OBJECT
+public:
+    static constexpr int VISIBLE_LIMIT = 10;
+
+    explicit CandidateStrip(QWidget *parent = nullptr);
+
+    static bool isRequested();
+
+    // Colours and fonts; re-measures only when the fonts changed
+    void setTheme(const PanelTheme &theme);
+    // One candidate per row instead of one row of candidates
+    void setVertical(bool vertical);
+    bool isVertical() const { return vertical_; }
+
+    void setCandidates(std::span<const QString> labels,
+                       std::span<const QString> texts,
+                       std::span<const QString> comments,
+                       const LookupChange &change,
+                       int cursor);
+
+    int count() const { return static_cast<int>(items_.size()); }
+    // First entry of the visible window
+    int firstVisible() const { return first_; }
+    int visibleCount() const { return std::min(count() - first_, VISIBLE_LIMIT); }
+    // Moves the window by delta entries, clamped to the table
+    void scrollBy(int delta);
+
+    // Hit testing in widget coordinates; -1 outside any visible candidate
+    int indexAt(const QPoint &pos) const;
+    // Empty for entries outside the visible window
+    QRect candidateRect(int index) const;
+
+    QSize sizeHint() const override;
+    QSize minimumSizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void changeEvent(QEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+
+private:
+    struct Item {
+        QString label;
+        QString text;
+        QString comment;
+        qreal labelWidth = 0;
+        qreal textWidth = 0;
+        qreal commentWidth = 0;
+        qreal x = 0;
+        qreal y = 0;
+        qreal width = 0;
+        // Widths are current; only window entries are measured
+        bool measured = false;
+    };
+
+    // Shaped runs for one window entry; entry i lives in slot i % VISIBLE_LIMIT,
+    // so the runs held never exceed one window however long the table is.
+    // The slot's entry alone says whose runs it holds; Item::measured only
+    // covers the widths and survives scrolling out
+    struct Runs {
+        int entry = -1;
+        QStaticText label;
+        QStaticText text;
+        QStaticText comment;
+    };
+
+    void refreshRowHeight();
+    void measure(int index);
+    void measureWindow();
+    void remeasureAll();
+    void relayout();
+    // Clamps the window to the table and, if asked, scrolls it to show index
+    void placeWindow(int index);
+    bool isScrollable() const { return count() > VISIBLE_LIMIT; }
+    QRect indicatorRect() const;
+
+    std::vector<Item> items_;
+    std::array<Runs, VISIBLE_LIMIT> runs_;
+    int cursor_ = -1;
+    int first_ = 0;
+    // Wheel delta below one notch, from high resolution touchpads
+    int wheelRemainder_ = 0;
+    bool vertical_ = false;
+    int contentWidth_ = 0;
+    int contentHeight_ = 0;
+    int rowHeight_ = 0;
+
+    QFont labelFont_;
+    QFont textFont_;
+    QColor primaryColor_;
+    QColor highlightColor_;
+    QColor commentColor_;
+    qreal devicePixelRatio_ = 1.0;
+};
@@ -0,0 +1,119 @@
+#include "DBusIoThread.h"
+
+#include "KimpanelInputmethodWatcher.h"
+
+#include <QDBusConnection>
+#include <QDBusError>
+#include <QDebug>
+
+DBusIoThread::DBusIoThread(KimpanelAdaptor *guiAdaptor, QObject *parent)
+    : QObject(parent), guiAdaptor_(guiAdaptor) {
+    thread_.setObjectName(QStringLiteral("kimpanel-dbus-io"));
+    connectionName_ = QStringLiteral("kimpanel-dbus-io");
+}
+
+DBusIoThread::~DBusIoThread() {
+    if (thread_.isRunning()) {
+        QMetaObject::invokeMethod(ioAnchor_, [this]() { teardownOnIoThread(); },
+                                  Qt::BlockingQueuedConnection);
+        thread_.quit();
+        thread_.wait();
+    }
+    delete ioAnchor_;
+}
+
+bool DBusIoThread::isRequested() {
+    return qEnvironmentVariableIntValue("KIMPANEL_DBUS_THREAD") > 0;
+}
+
+bool DBusIoThread::start(const QString &service, const QString &path) {
+    if (thread_.isRunning() || !guiAdaptor_) {
+        return registered_;
+    }
+    ioAnchor_ = new QObject;
+    ioAnchor_->moveToThread(&thread_);
+    thread_.start();
+    QMetaObject::invokeMethod(ioAnchor_, [this, service, path]() { setupOnIoThread(service, path); },
+                              Qt::BlockingQueuedConnection);
+    return registered_;
+}
+
+DBusIoThread::Stats DBusIoThread::stats() const {
+    Stats stats;
+    stats.published = published_.load(std::memory_order_relaxed);
+    stats.dropped = latest_.dropped();
+    stats.applied = applied_;
+    return stats;
+}
+
+QDBusConnection DBusIoThread::connection() const {
+    return QDBusConnection(connectionName_);
+}
+
+void DBusIoThread::setupOnIoThread(const QString &service, const QString &path) {
+    auto bus = QDBusConnection::connectToBus(QDBusConnection::SessionBus, connectionName_);
+    if (!bus.isConnected()) {
+        qWarning() << "[DBUS][io] Failed to connect to the session bus:" << bus.lastError().message();
+        return;
+    }
+    if (!bus.registerService(service)) {
+        qDebug() << "[DBUS][io] Failed to register" << service << "(probably already owned)";
+    } else {
+        qDebug() << "[DBUS][io] Successfully registered" << service;
+    }
+
+    ioAdaptor_ = new KimpanelAdaptor(ioAnchor_);
+    ioAdaptor_->setConnection(bus);
+    if (!bus.registerObject(path, ioAdaptor_,
+        QDBusConnection::ExportAllSlots | QDBusConnection::ExportScriptableSlots)) {
+        qWarning() << "[DBUS][io] Failed to register object at" << path;
+        return;
+    }
+    path_ = path;
+    registered_ = true;
+
+    ioWatcher_ = new KimpanelInputmethodWatcher(ioAdaptor_, bus,
+                                                KimpanelInputmethodWatcher::StateSignals,
+                                                ioAnchor_);
+
+    // Property traffic stays on the GUI thread; only outgoing TriggerProperty
+    // has to leave through the connection that owns the panel service
+    guiAdaptor_->setConnection(bus);
+
+    connect(ioAdaptor_, &KimpanelAdaptor::lookupTableChanged, ioAnchor_, [this]() { publishState(); });
+    connect(ioAdaptor_, &KimpanelAdaptor::spotChanged, ioAnchor_, [this]() { publishState(); });
+    connect(ioAdaptor_, &KimpanelAdaptor::auxChanged, ioAnchor_, [this]() { publishState(); });
+    connect(ioAdaptor_, &KimpanelAdaptor::lookupVisibleChanged, ioAnchor_, [this]() { publishState(); });
+    connect(ioAdaptor_, &KimpanelAdaptor::enabledChanged, ioAnchor_, [this]() { publishState(); });
+    connect(ioAdaptor_, &KimpanelAdaptor::preeditChanged, ioAnchor_, [this]() { publishState(); });
+}
+
+void DBusIoThread::teardownOnIoThread() {
+    auto bus = QDBusConnection(connectionName_);
+    if (registered_) {
+        bus.unregisterObject(path_);
+    }
+    delete ioWatcher_;
+    ioWatcher_ = nullptr;
+    delete ioAdaptor_;
+    ioAdaptor_ = nullptr;
+    QDBusConnection::disconnectFromBus(connectionName_);
+}
+
+void DBusIoThread::publishState() {
+    auto state = std::make_unique<PanelState>(ioAdaptor_->snapshot());
+    state->version = published_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (latest_.publish(std::move(state))) {
+        QMetaObject::invokeMethod(this, &DBusIoThread::drain, Qt::QueuedConnection);
+    }
+}
+
+void DBusIoThread::drain() {
+    const auto state = latest_.take();
+    if (!state || state->version <= lastAppliedVersion_) {
+        return;
+    }
+    lastAppliedVersion_ = state->version;
+    ++applied_;
+    guiAdaptor_->applySnapshot(*state);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "KimpanelAdaptor.h"
+#include "LatestValueSlot.h"
+
+#include <QDBusConnection>
+#include <QObject>
+#include <QThread>
+
+#include <atomic>
+
+class KimpanelInputmethodWatcher;
+
+// Runs org.kde.impanel2 reception and the per-keystroke inputmethod signals on
+// a dedicated thread with its own bus connection. The I/O side publishes
+// versioned PanelState snapshots into a latest-wins slot; the GUI thread only
+// applies the newest one, so intermediate states never reach the widgets.
+// Enabled with KIMPANEL_DBUS_THREAD=1.
+class DBusIoThread : public QObject {
+    Q_OBJECT
+public:
+    struct Stats {
+        quint64 published = 0;
+        quint64 dropped = 0;
+        quint64 applied = 0;
+    };
+
+    explicit DBusIoThread(KimpanelAdaptor *guiAdaptor, QObject *parent = nullptr);
+    ~DBusIoThread() override;
+
+    static bool isRequested();
+
+    // Connects, claims the panel service and registers the adaptor on the I/O
+    // thread; blocks until that is done
+    bool start(const QString &service, const QString &path);
+
+    Stats stats() const;
+    // Connection owning the panel service; valid after a successful start()
+    QDBusConnection connection() const;
+
+private:
+    void setupOnIoThread(const QString &service, const QString &path);
+    void teardownOnIoThread();
+    void publishState();
+    void drain();
+
+    KimpanelAdaptor *guiAdaptor_ = nullptr;
+    QThread thread_;
+    QObject *ioAnchor_ = nullptr;
+    KimpanelAdaptor *ioAdaptor_ = nullptr;
+    KimpanelInputmethodWatcher *ioWatcher_ = nullptr;
+    QString connectionName_;
+    QString path_;
+    bool registered_ = false;
+
+    LatestValueSlot<PanelState> latest_;
+    std::atomic<quint64> published_{0};
+    quint64 applied_ = 0;
+    quint64 lastAppliedVersion_ = 0;
+};
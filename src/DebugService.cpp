@@ -0,0 +1,69 @@
+#include "DebugService.h"
+
+#include "LatencyTracker.h"
+#include "PanelWindow.h"
+#include "StartupTimeline.h"
+#include "StaticTextCache.h"
+#include "Trace.h"
+
+DebugService::DebugService(QObject *parent)
+    : QObject(parent) {}
+
+const char *DebugService::path() {
+    return "/org/kde/impanel/Debug";
+}
+
+QStringList DebugService::DumpTrace() const {
+#if KIMPANEL_TRACE_ENABLED
+    return TraceRing::instance().dump();
+#else
+    return {};
+#endif
+}
+
+void DebugService::ClearTrace() {
+#if KIMPANEL_TRACE_ENABLED
+    TraceRing::instance().clear();
+#endif
+}
+
+QStringList DebugService::LatencyReport() const {
+    return LatencyTracker::instance().report();
+}
+
+QString DebugService::TextCacheStats() const {
+    const StaticTextCache::Stats stats = StaticTextCache::instance().stats();
+    const quint64 lookups = stats.hits + stats.misses;
+    return QStringLiteral("hits=%1 misses=%2 hit_rate=%3 entries=%4 clears=%5")
+        .arg(stats.hits)
+        .arg(stats.misses)
+        .arg(lookups ? double(stats.hits) / double(lookups) : 0.0, 0, 'f', 3)
+        .arg(stats.size)
+        .arg(stats.clears);
+}
+
+QString DebugService::WindowStats() const {
+    if (!panel_) {
+        return {};
+    }
+    const PanelWindow::PositionStats &position = panel_->positionStats();
+    const PanelWindow::SizingStats &sizing = panel_->sizingStats();
+    const PanelWindow::RepaintStats &repaint = panel_->repaintStats();
+    return QStringLiteral("moves=%1 moves_skipped=%2 resizes=%3 resizes_avoided=%4 "
+                          "frames=%5 repainted_px=%6 last_frame_px=%7")
+        .arg(position.moves)
+        .arg(position.movesSkipped)
+        .arg(sizing.resizes)
+        .arg(sizing.resizesAvoided)
+        .arg(repaint.frames)
+        .arg(repaint.pixels)
+        .arg(repaint.lastFramePixels);
+}
+
+QStringList DebugService::StartupReport() const {
+    return StartupTimeline::instance().report();
+}
+
+void DebugService::CycleInputMethod() {
+    emit cycleInputMethodRequested();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QObject>
+#include <QStringList>
+
+class PanelWindow;
+
+// Diagnostics for a running panel, exported on the panel bus connection at
+// /org/kde/impanel/Debug, e.g.
+//   busctl --user call org.kde.impanel /org/kde/impanel/Debug org.deepin.kimpanel.Debug DumpTrace
+class DebugService : public QObject {
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.deepin.kimpanel.Debug")
+public:
+    explicit DebugService(QObject *parent = nullptr);
+
+    static const char *path();
+
+    // The panel window is built lazily; WindowStats is empty until then
+    void setPanel(const PanelWindow *panel) { panel_ = panel; }
+
+public slots:
+    // Trace ring contents, oldest first; empty in release builds
+    Q_SCRIPTABLE QStringList DumpTrace() const;
+    Q_SCRIPTABLE void ClearTrace();
+    // Per-stage keystroke-to-pixels latency, see LatencyTracker
+    Q_SCRIPTABLE QStringList LatencyReport() const;
+    // Hit/miss counters of the candidate strip's shaped text cache
+    Q_SCRIPTABLE QString TextCacheStats() const;
+    // Window system traffic of the panel: moves and resizes sent and avoided,
+    // frames painted and device pixels repainted
+    Q_SCRIPTABLE QString WindowStats() const;
+    // Milestones since main(), see StartupTimeline
+    Q_SCRIPTABLE QStringList StartupReport() const;
+    // Same as a left click on the tray icon; drives the TriggerProperty/ExecMenu flow
+    Q_SCRIPTABLE void CycleInputMethod();
+
+signals:
+    void cycleInputMethodRequested();
+
+private:
+    const PanelWindow *panel_ = nullptr;
+};
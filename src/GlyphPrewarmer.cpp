@@ -0,0 +1,238 @@
+#include "GlyphPrewarmer.h"
+
+#include "StartupTimeline.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QFontMetrics>
+#include <QImage>
+#include <QPainter>
+#include <QSet>
+
+#include <algorithm>
+
+namespace {
+// Glyphs per drawText call; keeps each run inside the scratch image
+constexpr qsizetype LINE = 16;
+
+// CJK punctuation, then the GB2312 level 1 hanzi: the most frequent ones
+// first, the rest in GB2312 (pinyin) order, so a limit keeps the common ones
+constexpr char16_t COMMON_HANZI[] =
+    u"，。、？！：；“”‘’（）《》…—的一是不了在人有我他这个们中来上大为和国地到以说时要就出会可也"
+    u"你对生能而子那得于着下自之年过发后作里用道行所然家种事成方多经么去法学如都同现当没动面起看定天分"
+    u"还进好小部其些主样理心她本前开但因只从想实日军者意无力它与长把机十民第公此已工使情明性知全三又关"
+    u"点正业外将两高间由问很最重并物手应战向头文体政美相见被利什二等产或新己制身果加西斯月话合回特代内"
+    u"信表化老给世位次度门任常先海通教儿原东声提立及比员解水名真论处走义各入几口认条平系气题活尔更别打"
+    u"女变四神总何电数安少报才结反受目太量再感建务做接必场件计管期市直德资命山金指克许统区保至队形社便"
+    u"空决治展马科司五基眼书非则听白却界达光放强即像难且权思王象完设式色路记南品住告类求据程北边死张该"
+    u"交规万取拉格望觉术领共确传师观清今切院让识候带导争运笑飞风步改收根干造言联持组每济车亲极林服快办"
+    u"议往元英士证近失转夫令准布始怎呢存未远叫台单影具罗字爱击流备兵连调深商算质团集百需价花党华城石级"
+    u"整府离况亚请技际约示复病息究线似官火断精满支视消越器容照须九增研写称企八功吗包片史委乎查轻易早曾"
+    u"除农找装广显吧阿李标谈吃图念六引历首医局突专费号尽另周较注语仅考落青随选列武红响虽推势参希古众构"
+    u"房半节土投某案黑维革划敌致陈律足态护七兴派孩验责营星够章音跟志底站严巴例防族供效续施留讲型料终答"
+    u"紧黄绝奇察母京段依批群项故按河米围江织害斗双境客纪采举杀攻父苏密低朝友诉止细愿千值仍男钱破网热助"
+    u"倒育属坐帝限船脸职速刻乐否刚威毛状率甚独球般普怕弹校苦创假久错承印晚兰试股拿脑预谁益阳若哪微尼继"
+    u"送急血惊伤素药适波夜省初喜卫源食险待述陆习置居劳财环排福纳欢雷警获模充负云停木游龙树疑层冷洲冲射"
+    u"略范竟句室异激汉村哈策演简卡罪判担州静退既衣您宗积余痛检差富灵协角占配征修皮挥胜降阶审沉坚善妈刘"
+    u"读啊超免压银买皇养伊怀执副乱抗犯追帮宣佛岁航优怪香著田铁控税左右份穿艺背阵草脚概恶块顿敢守酒岛托"
+    u"央户烈洋哥索胡款靠评版宝座释景顾弟登货互付伯慢欧换闻危忙核暗姐介坏讨丽良序升监临亮露永呼味野架域"
+    u"沙掉括舰鱼杂误湾吉减编楚肯测败屋跑梦散温困剑渐封救贵枪缺楼县尚毫移娘朋画班智亦耳恩短掌恐遗固席松"
+    u"秘谢鲁遇康虑幸均销钟诗藏赶剧票损忽巨炮旧端探湖录叶春乡附吸予礼港雨呀板庭妇归睛饭额含顺输摇招婚脱"
+    u"补谓督毒油疗旅泽材灭逐莫笔亡鲜词圣择寻厂睡博勒烟授诺伦岸奥唐卖俄炸载洛健堂旁宫喝借君禁阴园谋宋避"
+    u"抓荣姑孙逃牙束跳顶玉镇雪午练迫爷篇肉嘴馆遍凡础洞卷坦牛宁纸诸训私庄祖丝翻暴森塔默握戏隐熟骨访弱蒙"
+    u"歌店鬼软典欲萨伙遭盘爸扩盖弄雄稳忘亿刺拥徒姆杨齐赛趣曲刀床迎冰虚玩析窗醒妻透购替塞努休虎扬途侵刑"
+    u"绿兄迅套贸毕唯谷轮库迹尤竞街促延震弃甲伟麻川申缓潜闪售灯针哲络抵朱埃抱鼓植纯夏忍页杰筑折郑贝尊吴"
+    u"秀混臣雅振染盛怒舞圆搞狂措姓残秋培迷诚宽宇猛摆梅毁伸摩盟末乃悲拍丁赵挨哎唉哀皑癌蔼矮艾碍隘鞍氨俺"
+    u"胺肮昂盎凹敖熬翱袄傲懊澳芭捌扒叭笆疤拔跋靶耙坝霸罢柏佰拜稗斑搬扳颁扮拌伴瓣绊邦梆榜膀绑棒磅蚌镑傍"
+    u"谤苞胞褒剥薄雹堡饱豹鲍爆杯碑卑辈钡倍狈惫焙奔苯笨崩绷甭泵蹦迸逼鼻鄙彼碧蓖蔽毙毖币庇痹闭敝弊辟壁臂"
+    u"陛鞭贬扁卞辨辩辫彪膘鳖憋瘪彬斌濒滨宾摈柄丙秉饼炳玻菠播拨钵勃搏铂箔帛舶脖膊渤泊驳捕卜哺埠簿怖擦猜"
+    u"裁睬踩彩菜蔡餐蚕惭惨灿苍舱仓沧操糙槽曹厕侧册蹭插叉茬茶碴搽岔诧拆柴豺搀掺蝉馋谗缠铲阐颤昌猖尝偿肠"
+    u"敞畅唱倡抄钞嘲潮巢吵炒扯撤掣彻澈郴辰尘晨忱趁衬撑橙呈乘惩澄逞骋秤痴匙池迟弛驰耻齿侈尺赤翅斥炽虫崇"
+    u"宠抽酬畴踌稠愁筹仇绸瞅丑臭橱厨躇锄雏滁储矗搐触揣椽喘串疮幢闯吹炊捶锤垂椿醇唇淳蠢戳绰疵茨磁雌辞慈"
+    u"瓷赐聪葱囱匆丛凑粗醋簇蹿篡窜摧崔催脆瘁粹淬翠寸磋撮搓挫搭瘩呆歹傣戴殆贷袋逮怠耽丹郸掸胆旦氮惮淡诞"
+    u"蛋挡荡档捣蹈祷稻悼盗蹬瞪凳邓堤滴迪笛狄涤翟嫡蒂递缔颠掂滇碘靛垫佃甸惦奠淀殿碉叼雕凋刁吊钓跌爹碟蝶"
+    u"迭谍叠盯叮钉鼎锭订丢冬董懂栋侗恫冻兜抖陡豆逗痘犊堵睹赌杜镀肚渡妒锻缎堆兑墩吨蹲敦囤钝盾遁掇哆夺垛"
+    u"躲朵跺舵剁惰堕蛾峨鹅讹娥厄扼遏鄂饿饵洱贰罚筏伐乏阀珐藩帆番樊矾钒繁烦返贩泛坊芳肪妨仿纺菲啡肥匪诽"
+    u"吠肺废沸芬酚吩氛纷坟焚汾粉奋忿愤粪丰枫蜂峰锋疯烽逢冯缝讽奉凤敷肤孵扶拂辐幅氟符伏俘浮涪袱弗甫抚辅"
+    u"俯釜斧脯腑腐赴覆赋傅阜腹讣缚咐噶嘎钙溉甘杆柑竿肝秆赣冈钢缸肛纲岗杠篙皋膏羔糕镐稿搁戈鸽胳疙割葛蛤"
+    u"阁隔铬耕庚羹埂耿梗恭龚躬弓巩汞拱贡钩勾沟苟狗垢辜菇咕箍估沽孤蛊雇刮瓜剐寡挂褂乖拐棺冠罐惯灌贯逛瑰"
+    u"圭硅龟闺轨诡癸桂柜跪刽辊滚棍锅郭裹骸氦亥骇酣憨邯韩涵寒函喊罕翰撼捍旱憾悍焊汗夯杭壕嚎豪郝耗浩呵荷"
+    u"菏禾盒貉阂涸赫褐鹤贺嘿痕狠恨哼亨横衡恒轰哄烘虹鸿洪宏弘喉侯猴吼厚瑚壶葫蝴狐糊弧唬沪哗猾滑槐徊淮桓"
+    u"患唤痪豢焕涣宦幻荒慌磺蝗簧凰惶煌晃幌恍谎灰辉徽恢蛔悔慧卉惠晦贿秽烩汇讳诲绘荤昏魂浑豁惑霍祸圾畸稽"
+    u"箕肌饥讥鸡姬绩缉棘辑籍疾汲嫉挤脊蓟冀季伎祭剂悸寄寂忌妓嘉枷夹佳荚颊贾钾稼驾嫁歼尖笺煎兼肩艰奸缄茧"
+    u"柬碱硷拣捡俭剪荐槛鉴践贱键箭饯溅涧僵姜浆疆蒋桨奖匠酱蕉椒礁焦胶郊浇骄娇嚼搅铰矫侥狡饺缴绞剿酵轿窖"
+    u"揭皆秸截劫桔捷睫竭洁戒藉芥疥诫届巾筋斤津襟锦谨靳晋烬浸劲荆兢茎晶鲸粳井颈敬镜径痉靖净炯窘揪纠玖韭"
+    u"灸厩臼舅咎疚鞠拘狙疽驹菊咀矩沮聚拒距踞锯俱惧炬捐鹃娟倦眷绢撅攫抉掘倔爵诀菌钧峻俊竣浚郡骏喀咖咯揩"
+    u"楷凯慨刊堪勘坎砍慷糠扛亢炕拷烤坷苛柯棵磕颗壳咳渴课啃垦恳坑吭孔抠扣寇枯哭窟酷裤夸垮挎跨胯筷侩匡筐"
+    u"框矿眶旷亏盔岿窥葵奎魁傀馈愧溃坤昆捆廓阔垃喇蜡腊辣啦莱赖蓝婪栏拦篮阑澜谰揽览懒缆烂滥琅榔狼廊郎朗"
+    u"浪捞牢佬姥酪烙涝镭蕾磊累儡垒擂肋泪棱楞厘梨犁黎篱狸漓鲤莉荔吏栗厉励砾傈俐痢粒沥隶璃哩俩莲镰廉怜涟"
+    u"帘敛链恋炼粮凉梁粱辆晾谅撩聊僚燎寥辽潦撂镣廖裂劣猎琳磷霖邻鳞淋凛赁吝拎玲菱零龄铃伶羚凌陵岭溜琉榴"
+    u"硫馏瘤柳聋咙笼窿隆垄拢陇娄搂篓漏陋芦卢颅庐炉掳卤虏麓碌赂鹿潞禄戮驴吕铝侣履屡缕氯滤峦挛孪滦卵掠抡"
+    u"仑沦纶萝螺逻锣箩骡裸骆玛码蚂骂嘛埋麦迈脉瞒馒蛮蔓曼漫谩芒茫盲氓莽猫茅锚矛铆卯茂冒帽貌玫枚酶霉煤眉"
+    u"媒镁昧寐妹媚闷萌檬锰孟眯醚靡糜谜弥觅泌蜜幂棉眠绵冕勉娩缅苗描瞄藐秒渺庙妙蔑抿皿敏悯闽螟鸣铭谬摸摹"
+    u"蘑膜磨魔抹墨沫漠寞陌牟拇牡亩墓暮幕募慕睦牧穆呐钠娜氖奶耐奈囊挠恼闹淖馁嫩妮霓倪泥拟匿腻逆溺蔫拈碾"
+    u"撵捻酿鸟尿捏聂孽啮镊镍涅柠狞凝拧泞扭钮纽脓浓奴暖虐疟挪懦糯哦鸥殴藕呕偶沤啪趴爬帕琶牌徘湃攀潘磐盼"
+    u"畔叛乓庞耪胖抛咆刨袍泡呸胚裴赔陪佩沛喷盆砰抨烹澎彭蓬棚硼篷膨鹏捧碰坯砒霹披劈琵毗啤脾疲匹痞僻屁譬"
+    u"偏骗飘漂瓢撇瞥拼频贫聘乒坪苹萍凭瓶屏坡泼颇婆魄粕剖扑铺仆莆葡菩蒲埔朴圃浦谱曝瀑欺栖戚凄漆柒沏棋歧"
+    u"畦崎脐旗祈祁骑岂乞启契砌迄汽泣讫掐恰洽牵扦钎铅迁签仟谦乾黔钳遣浅谴堑嵌欠歉呛腔羌墙蔷抢橇锹敲悄桥"
+    u"瞧乔侨巧鞘撬翘峭俏窍茄怯窃钦秦琴勤芹擒禽寝沁氢倾卿擎晴氰顷庆琼穷丘邱囚酋泅趋蛆躯屈驱渠娶龋圈颧醛"
+    u"泉痊拳犬券劝炔瘸鹊榷雀裙燃冉瓤壤攘嚷饶扰绕惹壬仁韧刃妊纫扔戎茸蓉融熔溶绒冗揉柔茹蠕儒孺辱乳汝褥阮"
+    u"蕊瑞锐闰润撒洒腮鳃叁伞桑嗓丧搔骚扫嫂瑟涩僧莎砂刹纱傻啥煞筛晒珊苫杉删煽衫陕擅赡膳汕扇缮墒赏晌裳梢"
+    u"捎稍烧芍勺韶哨邵绍奢赊蛇舌舍赦摄慑涉砷呻娠绅沈婶肾慎渗甥牲绳剩狮湿尸虱拾蚀矢屎驶柿拭誓逝嗜噬仕侍"
+    u"饰氏恃寿瘦兽蔬枢梳殊抒叔舒淑疏赎孰薯暑曙署蜀黍鼠戍竖墅庶漱恕刷耍摔衰甩帅栓拴霜爽吮瞬舜硕朔烁撕嘶"
+    u"肆寺嗣伺饲巳耸怂颂讼诵搜艘擞嗽酥俗粟僳塑溯宿肃酸蒜隋绥髓碎穗遂隧祟笋蓑梭唆缩琐锁塌獭挞蹋踏胎苔抬"
+    u"泰酞汰坍摊贪瘫滩坛檀痰潭谭毯袒碳叹炭汤塘搪棠膛糖倘躺淌趟烫掏涛滔绦萄桃淘陶藤腾疼誊梯剔踢锑蹄啼嚏"
+    u"惕涕剃屉添填甜恬舔腆挑迢眺贴帖厅烃汀廷亭挺艇桐酮瞳铜彤童桶捅筒偷凸秃涂屠吐兔湍颓腿蜕褪吞屯臀拖鸵"
+    u"陀驮驼椭妥拓唾挖哇蛙洼娃瓦袜歪豌弯顽丸烷碗挽皖惋宛婉腕汪枉旺妄巍韦违桅惟潍苇萎伪尾纬蔚畏胃喂魏渭"
+    u"尉慰瘟蚊纹吻紊嗡翁瓮挝蜗涡窝斡卧沃巫呜钨乌污诬芜梧吾毋捂伍侮坞戊雾晤勿悟昔熙硒矽晰嘻锡牺稀悉膝夕"
+    u"惜熄烯溪汐犀檄袭媳铣洗隙瞎虾匣霞辖暇峡侠狭厦吓掀锨仙纤咸贤衔舷闲涎弦嫌献腺馅羡宪陷厢镶箱襄湘翔祥"
+    u"详享巷橡萧硝霄削哮嚣宵淆晓孝肖啸楔歇蝎鞋挟携邪斜胁谐械卸蟹懈泄泻屑薪芯锌欣辛忻衅腥猩惺邢杏凶胸匈"
+    u"汹熊羞朽嗅锈袖绣墟戌嘘徐蓄酗叙旭畜恤絮婿绪轩喧悬旋玄癣眩绚靴薛穴勋熏循旬询驯巡殉汛讯逊押鸦鸭丫芽"
+    u"蚜崖衙涯哑讶焉咽阉淹盐蜒岩颜阎炎沿奄掩衍艳堰燕厌砚雁唁彦焰宴谚殃鸯秧佯疡羊氧仰痒漾邀腰妖瑶尧遥窑"
+    u"谣姚咬舀耀椰噎耶冶掖曳腋液壹揖铱颐夷仪胰沂宜姨彝椅蚁倚乙矣抑邑屹役臆逸肄疫裔毅忆溢诣谊译翼翌绎茵"
+    u"荫殷姻吟淫寅饮尹樱婴鹰缨莹萤荧蝇赢盈颖硬映哟佣臃痈庸雍踊蛹咏泳涌恿勇幽悠忧邮铀犹酉佑釉诱幼迂淤盂"
+    u"榆虞愚舆俞逾愉渝渔隅娱屿禹羽芋郁吁喻峪御愈狱誉浴寓裕豫驭鸳渊冤垣袁援辕猿缘苑怨曰跃钥岳粤悦阅耘郧"
+    u"匀陨允蕴酝晕韵孕匝砸栽哉灾宰咱攒暂赞赃脏葬糟凿藻枣澡蚤躁噪皂灶燥贼憎赠扎喳渣札轧铡闸眨栅榨咋乍诈"
+    u"摘斋宅窄债寨瞻毡詹粘沾盏斩辗崭蘸栈湛绽樟彰漳涨杖丈帐账仗胀瘴障昭沼罩兆肇召遮蛰辙锗蔗浙珍斟甄砧臻"
+    u"贞侦枕疹诊蒸挣睁狰怔拯帧症芝枝吱蜘肢脂汁殖侄址趾旨挚掷帜峙秩稚炙痔滞窒盅忠衷肿仲舟诌粥轴肘帚咒皱"
+    u"宙昼骤珠株蛛猪诛竹烛煮拄瞩嘱柱蛀贮铸祝驻爪拽砖撰赚篆桩妆撞壮椎锥赘坠缀谆捉拙卓桌琢茁酌啄灼浊兹咨"
+    u"姿滋淄孜紫仔籽滓渍鬃棕踪综纵邹奏揍租卒诅阻钻纂醉遵昨佐柞";
+
+// End of a run of at most count code units from start, not splitting a surrogate pair
+qsizetype runEnd(QStringView text, qsizetype start, qsizetype count) {
+    qsizetype end = std::min(text.size(), start + count);
+    if (end < text.size() && text.at(end - 1).isHighSurrogate()) {
+        ++end;
+    }
+    return end;
+}
+}
+
+GlyphPrewarmer::GlyphPrewarmer(const PanelTheme &theme, qreal devicePixelRatio,
+                               std::function<bool()> busy, QObject *parent)
+    : QObject(parent),
+      labelFont_(theme.labelFont),
+      candidateFont_(theme.candidateFont),
+      auxFont_(theme.auxFont),
+      devicePixelRatio_(devicePixelRatio),
+      busy_(std::move(busy)) {
+    timer_.setSingleShot(true);
+    connect(&timer_, &QTimer::timeout, this, &GlyphPrewarmer::step);
+}
+
+QString GlyphPrewarmer::characters() {
+    QString combined;
+    const QString path = qEnvironmentVariable("KIMPANEL_PREWARM_FILE");
+    if (!path.isEmpty()) {
+        QFile file(path);
+        if (file.open(QIODevice::ReadOnly)) {
+            combined = QString::fromUtf8(file.readAll());
+        } else {
+            qWarning() << "[Prewarm] Cannot read" << path << file.errorString();
+        }
+    }
+    combined += QStringView(COMMON_HANZI);
+
+    const int limit = qEnvironmentVariableIsSet("KIMPANEL_PREWARM_LIMIT")
+        ? qEnvironmentVariableIntValue("KIMPANEL_PREWARM_LIMIT")
+        : -1;
+    QString characters;
+    QSet<char32_t> seen;
+    const QList<uint> codePoints = combined.toUcs4();
+    for (uint codePoint : codePoints) {
+        if (limit >= 0 && seen.size() >= limit) {
+            break;
+        }
+        if (QChar::isSpace(codePoint) || seen.contains(codePoint)) {
+            continue;
+        }
+        seen.insert(codePoint);
+        characters += QChar::fromUcs4(codePoint);
+    }
+    return characters;
+}
+
+void GlyphPrewarmer::setTheme(const PanelTheme &theme, qreal devicePixelRatio) {
+    if (theme.labelFont == labelFont_ && theme.candidateFont == candidateFont_
+        && theme.auxFont == auxFont_ && devicePixelRatio == devicePixelRatio_) {
+        return;
+    }
+    labelFont_ = theme.labelFont;
+    candidateFont_ = theme.candidateFont;
+    auxFont_ = theme.auxFont;
+    devicePixelRatio_ = devicePixelRatio;
+    // Glyphs warmed so far belong to the old fonts; go through the list again
+    if (started_) {
+        start();
+    }
+}
+
+void GlyphPrewarmer::start() {
+    started_ = true;
+    queue_ = characters();
+    position_ = 0;
+    busyNs_ = 0;
+    if (queue_.isEmpty()) {
+        return;
+    }
+    wall_.start();
+    timer_.start(0);
+}
+
+void GlyphPrewarmer::step() {
+    // Never compete with a visible panel; pick up again once it hides
+    if (busy_ && busy_()) {
+        timer_.start(BUSY_RETRY_MS);
+        return;
+    }
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    if (position_ == 0) {
+        // Labels and the pinyin aux string are ASCII
+        QString ascii;
+        for (char16_t c = 0x21; c < 0x7f; ++c) {
+            ascii += QChar(c);
+        }
+        draw(labelFont_, ascii);
+        draw(auxFont_, ascii);
+        draw(candidateFont_, ascii);
+    }
+    const qsizetype end = runEnd(queue_, position_, CHUNK);
+    draw(candidateFont_, QStringView(queue_).mid(position_, end - position_));
+    position_ = end;
+    busyNs_ += elapsed.nsecsElapsed();
+
+    if (position_ < queue_.size()) {
+        timer_.start(0);
+        return;
+    }
+    const qsizetype glyphs = queue_.toUcs4().size();
+    queue_.clear();
+    StartupTimeline::instance().mark(StartupTimeline::GlyphsWarmed);
+    qInfo().noquote() << QStringLiteral("[Prewarm] %1 characters in %2ms of GUI time over %3ms")
+                             .arg(glyphs)
+                             .arg(busyNs_ / 1e6, 0, 'f', 1)
+                             .arg(wall_.nsecsElapsed() / 1e6, 0, 'f', 1);
+}
+
+void GlyphPrewarmer::draw(const QFont &font, QStringView text) {
+    if (text.isEmpty()) {
+        return;
+    }
+    // Same format and scale as the panel's backing store, so the raster
+    // engine fills the glyph cache entries the panel will look up
+    const QFontMetrics metrics(font);
+    QImage canvas(QSize(metrics.height() * LINE, metrics.height()) * devicePixelRatio_,
+                  QImage::Format_ARGB32_Premultiplied);
+    canvas.setDevicePixelRatio(devicePixelRatio_);
+    canvas.fill(Qt::transparent);
+
+    QPainter painter(&canvas);
+    painter.setFont(font);
+    for (qsizetype start = 0; start < text.size();) {
+        const qsizetype end = runEnd(text, start, LINE);
+        painter.drawText(QPointF(0, metrics.ascent()), text.mid(start, end - start).toString());
+        start = end;
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "PanelTheme.h"
+
+#include <QElapsedTimer>
+#include <QFont>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+#include <functional>
+
+// Resolves the panel fonts' fallback chain and fills Qt's glyph cache for
+// common hanzi, digits and ASCII in idle time, so the first candidate box after
+// login does not pay for fontconfig fallback and rasterization. Font engines
+// and glyph caches are per thread, so this runs on the GUI thread in CHUNK
+// sized steps that yield to the event loop.
+//
+// KIMPANEL_PREWARM_FILE names a UTF-8 file whose characters are warmed before
+// the built-in list; KIMPANEL_PREWARM_LIMIT caps the number of characters
+// (0 disables warming).
+class GlyphPrewarmer : public QObject {
+    Q_OBJECT
+public:
+    static constexpr qsizetype CHUNK = 64;
+    // Retry delay while busy() reports the panel is in use
+    static constexpr int BUSY_RETRY_MS = 100;
+
+    GlyphPrewarmer(const PanelTheme &theme, qreal devicePixelRatio,
+                   std::function<bool()> busy, QObject *parent = nullptr);
+
+    // The characters to warm, deduplicated and capped
+    static QString characters();
+
+    // Restarts a started warm-up when the fonts or the scale changed
+    void setTheme(const PanelTheme &theme, qreal devicePixelRatio);
+    void start();
+    bool isRunning() const { return !queue_.isEmpty(); }
+
+private:
+    void step();
+    void draw(const QFont &font, QStringView text);
+
+    QFont labelFont_;
+    QFont candidateFont_;
+    QFont auxFont_;
+    qreal devicePixelRatio_ = 1.0;
+    std::function<bool()> busy_;
+
+    QTimer timer_;
+    QString queue_;
+    qsizetype position_ = 0;
+    bool started_ = false;
+    qint64 busyNs_ = 0;
+    QElapsedTimer wall_;
+};
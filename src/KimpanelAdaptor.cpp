@@ -1,4 +1,9 @@
 #include "KimpanelAdaptor.h"
+#include "AllocationCounter.h"
+#include "BusTrace.h"
+#include "LatencyTracker.h"
+#include "PropertyParser.h"
+#include "Trace.h"
 #include <QDBusConnection>
 #include <QDBusMessage>
 #include <QDBusPendingCall>
@@ -12,69 +17,176 @@ constexpr const char *PANEL_PATH = "/org/kde/impanel";
 constexpr const char *PANEL_INTERFACE = "org.kde.impanel";
 }
 
-namespace {
-KimpanelAdaptor::Property parsePropertyString(const QString &raw) {
-    KimpanelAdaptor::Property prop;
-    if (raw.isEmpty()) {
-        return prop;
-    }
-    const QStringList parts = raw.split(QLatin1Char(':'), Qt::KeepEmptyParts);
-    if (parts.size() < 4) {
-        return prop;
-    }
-    prop.key = parts.value(0);
-    prop.label = parts.value(1);
-    prop.icon = parts.value(2);
-    prop.tip = parts.value(3);
-    if (parts.size() > 4) {
-        prop.hint = parts.mid(4).join(QLatin1Char(':'));
-    }
-    return prop;
-}
-
-QVector<KimpanelAdaptor::Property> parsePropertyList(const QStringList &list) {
-    QVector<KimpanelAdaptor::Property> parsed;
-    parsed.reserve(list.size());
-    for (const QString &raw : list) {
-        auto prop = parsePropertyString(raw);
-        if (prop.isValid()) {
-            parsed.push_back(std::move(prop));
-        }
+void LookupChange::markChanged(int index) {
+    if (firstChanged < 0 || index < firstChanged) {
+        firstChanged = index;
+    }
+    if (index > lastChanged) {
+        lastChanged = index;
+    }
+}
+
+void LookupChange::merge(const LookupChange &next) {
+    cursor = next.cursor;
+    if (next.hasTextChanges()) {
+        markChanged(next.firstChanged);
+        markChanged(next.lastChanged);
     }
-    return parsed;
+    countChanged = countChanged || next.countChanged;
+    pageFlagsChanged = pageFlagsChanged || next.pageFlagsChanged;
+    layoutChanged = layoutChanged || next.layoutChanged;
 }
+
+LookupChange LookupChange::all(int count, int cursor) {
+    LookupChange change;
+    change.cursor = cursor;
+    change.countChanged = true;
+    change.pageFlagsChanged = true;
+    change.layoutChanged = true;
+    if (count > 0) {
+        change.firstChanged = 0;
+        change.lastChanged = count - 1;
+    }
+    return change;
 }
 
 KimpanelAdaptor::KimpanelAdaptor(QObject *parent) : QObject(parent) {}
 
+void KimpanelAdaptor::recordCall(const char *member) {
+    BusTraceRecorder *recorder = BusTraceRecorder::active();
+    // Nested calls from another exported slot carry that slot's message
+    if (recorder && calledFromDBus() && message().member() == QLatin1String(member)) {
+        recorder->record(BusTrace::Source::PanelCall, message());
+    }
+}
+
 void KimpanelAdaptor::SetSpotRect(int x, int y, int w, int h) {
-    qDebug() << "[POSITIONING] SetSpotRect called:" 
-             << "x=" << x << "y=" << y << "w=" << w << "h=" << h;
-    spot_.x=x; spot_.y=y; spot_.w=w; spot_.h=h;
-    qDebug() << "[POSITIONING] Emitting spotChanged signal";
+    recordCall("SetSpotRect");
+    KIMPANEL_TRACE(lcTracePositioning, "SetSpotRect x=%1 y=%2 w=%3 h=%4", x, y, w, h);
+    // Terminals and browsers resend the caret on every repaint
+    const SpotRect spot{x, y, w, h};
+    if (spot == spot_) {
+        return;
+    }
+    spot_ = spot;
     emit spotChanged();
 }
 
-void KimpanelAdaptor::SetLookupTable(const QStringList &labels,
-                                     const QStringList &texts,
-                                     const QStringList &comments,
+void KimpanelAdaptor::SetLookupTable(QStringList labels,
+                                     QStringList texts,
+                                     QStringList comments,
                                      bool hasPrev, bool hasNext,
                                      int cursor, int layout) {
-    data_.labels = labels;
-    data_.texts = texts;
-    data_.comments = comments;
+    const qint64 received = LatencyTracker::now();
+    recordCall("SetLookupTable");
+    const AllocationScope allocations;
+    LookupChange change;
+    change.previousCursor = data_.cursor;
+    change.cursor = cursor;
+    change.countChanged = texts.size() != data_.texts.size();
+    change.pageFlagsChanged = hasPrev != data_.hasPrev || hasNext != data_.hasNext;
+    change.layoutChanged = layout != data_.layout;
+
+    const int previousCount = data_.texts.size();
+    for (int i = 0; i < texts.size(); ++i) {
+        if (i >= previousCount
+            || texts.at(i) != data_.texts.at(i)
+            || labels.value(i) != data_.labels.value(i)
+            || comments.value(i) != data_.comments.value(i)) {
+            change.markChanged(i);
+        }
+    }
+
+    data_.labels = std::move(labels);
+    data_.texts = std::move(texts);
+    data_.comments = std::move(comments);
     data_.hasPrev = hasPrev;
     data_.hasNext = hasNext;
     data_.cursor = cursor;
     data_.layout = layout;
+
+    lastLookupAllocations_ = allocations.count();
+    lookupAllocations_ += lastLookupAllocations_;
+    KIMPANEL_TRACE(lcTraceLookup, "SetLookupTable count=%1 cursor=%2 changed=%3..%4 allocations=%5",
+                   data_.texts.size(), cursor, change.firstChanged, change.lastChanged,
+                   lastLookupAllocations_);
+    if (change.isEmpty()) {
+        return;
+    }
+    LatencyTracker::instance().markReceipt(received);
+    emit lookupTableChanged(change);
     emit lookupChanged();
 }
 
+void KimpanelAdaptor::setLookupCursor(int cursor) {
+    SetLookupTable(data_.labels, data_.texts, data_.comments,
+                   data_.hasPrev, data_.hasNext, cursor, data_.layout);
+}
+
+void KimpanelAdaptor::setAuxAttributes(const QString &attr) {
+    auto attributes = parseTextAttributes(attr);
+    if (attributes == auxAttributes_) {
+        return;
+    }
+    auxAttributes_ = std::move(attributes);
+    emit auxChanged();
+}
+
+void KimpanelAdaptor::setPreeditText(const QString &text, const QString &attr) {
+    auto attributes = parseTextAttributes(attr);
+    if (text == preeditText_ && attributes == preeditAttributes_) {
+        return;
+    }
+    preeditText_ = text;
+    preeditAttributes_ = std::move(attributes);
+    emit preeditChanged();
+}
+
+PanelState KimpanelAdaptor::snapshot() const {
+    PanelState state;
+    state.lookup = data_;
+    state.spot = spot_;
+    state.auxText = auxText_;
+    state.auxAttributes = auxAttributes_;
+    state.preeditText = preeditText_;
+    state.preeditAttributes = preeditAttributes_;
+    state.preeditCaret = preeditCaret_;
+    state.preeditVisible = preeditVisible_;
+    state.auxVisible = auxVisible_;
+    state.lookupVisible = lookupVisible_;
+    state.enabled = enabled_;
+    return state;
+}
+
+void KimpanelAdaptor::applySnapshot(const PanelState &state) {
+    const LookupData &lookup = state.lookup;
+    SetLookupTable(lookup.labels, lookup.texts, lookup.comments,
+                   lookup.hasPrev, lookup.hasNext, lookup.cursor, lookup.layout);
+    if (state.spot != spot_) {
+        SetSpotRect(state.spot.x, state.spot.y, state.spot.w, state.spot.h);
+    }
+    setAuxText(state.auxText);
+    if (state.auxAttributes != auxAttributes_) {
+        auxAttributes_ = state.auxAttributes;
+        emit auxChanged();
+    }
+    if (state.preeditText != preeditText_ || state.preeditAttributes != preeditAttributes_) {
+        preeditText_ = state.preeditText;
+        preeditAttributes_ = state.preeditAttributes;
+        emit preeditChanged();
+    }
+    setPreeditCaret(state.preeditCaret);
+    setPreeditVisible(state.preeditVisible);
+    setAuxVisible(state.auxVisible);
+    setLookupVisible(state.lookupVisible);
+    setEnabled(state.enabled);
+}
+
 void KimpanelAdaptor::triggerProperty(const QString &key) {
     if (key.isEmpty()) {
         return;
     }
-    if (!QDBusConnection::sessionBus().isConnected()) {
+    if (!bus_.isConnected()) {
         qWarning() << "[DBUS][panel] No session bus available for TriggerProperty" << key;
         return;
     }
@@ -82,68 +194,39 @@ void KimpanelAdaptor::triggerProperty(const QString &key) {
                                           PANEL_INTERFACE,
                                           QStringLiteral("TriggerProperty"));
     msg << key;
-    QDBusConnection::sessionBus().send(msg);
+    bus_.send(msg);
 }
 
 std::optional<KimpanelAdaptor::Property> KimpanelAdaptor::propertyForKey(const QString &key) const {
-    const int idx = propertyIndex(key);
-    if (idx < 0) {
+    const Property *prop = properties_.find(key);
+    if (!prop) {
         return std::nullopt;
     }
-    return properties_.at(idx);
+    return *prop;
 }
 
 void KimpanelAdaptor::handleRegisterProperties(const QStringList &props) {
-    QVector<Property> parsed = parsePropertyList(props);
-
-    const bool changed = (parsed != properties_);
-    properties_ = std::move(parsed);
-    if (changed) {
-        emit propertiesChanged();
-    }
-    for (const auto &prop : properties_) {
-        emit propertyChanged(prop.key);
+    const PropertyChangeSet changes = properties_.replaceAll(PropertyParser::parsePropertyList(props));
+    if (!changes.isEmpty()) {
+        emit propertiesUpdated(changes);
     }
 }
 
 void KimpanelAdaptor::handleUpdateProperty(const QString &propString) {
-    auto prop = parsePropertyString(propString);
-    if (!prop.isValid()) {
-        return;
-    }
-    const int idx = propertyIndex(prop.key);
-    if (idx >= 0) {
-        if (properties_.at(idx) == prop) {
-            return;
-        }
-        properties_[idx] = std::move(prop);
-    } else {
-        properties_.push_back(std::move(prop));
-        emit propertiesChanged();
+    const PropertyChangeSet changes = properties_.upsert(PropertyParser::parseProperty(propString));
+    if (!changes.isEmpty()) {
+        emit propertiesUpdated(changes);
     }
-    emit propertyChanged(prop.key);
 }
 
 void KimpanelAdaptor::handleRemoveProperty(const QString &key) {
-    const int idx = propertyIndex(key);
-    if (idx < 0) {
-        return;
+    const PropertyChangeSet changes = properties_.remove(key);
+    if (!changes.isEmpty()) {
+        emit propertiesUpdated(changes);
     }
-    properties_.removeAt(idx);
-    emit propertiesChanged();
-    emit propertyChanged(key);
 }
 
 void KimpanelAdaptor::handleExecMenu(const QStringList &entries) {
-    const QVector<Property> parsed = parsePropertyList(entries);
+    const QVector<Property> parsed = PropertyParser::parsePropertyList(entries);
     emit execMenuReceived(parsed);
 }
-
-int KimpanelAdaptor::propertyIndex(const QString &key) const {
-    for (int i = 0; i < properties_.size(); ++i) {
-        if (properties_.at(i).key == key) {
-            return i;
-        }
-    }
-    return -1;
-}
@@ -1,21 +1,86 @@
 #pragma once
+#include "PropertyStore.h"
+#include "TextAttribute.h"
+
+#include <QDBusConnection>
+#include <QDBusContext>
 #include <QObject>
 #include <QStringList>
 #include <QVector>
 
 #include <optional>
+#include <span>
 
 struct LookupData {
+    // Candidate orientation requested by the engine
+    enum LayoutHint {
+        LayoutNotSet = 0,
+        LayoutVertical = 1,
+        LayoutHorizontal = 2,
+    };
+
     QStringList labels;
     QStringList texts;
     QStringList comments;
     bool hasPrev = false;
     bool hasNext = false;
     int cursor = -1;
-    int layout = 0;
+    // A LayoutHint; unknown values are treated as LayoutNotSet
+    int layout = LayoutNotSet;
+};
+
+struct SpotRect {
+    int x = 0;
+    int y = 0;
+    int w = 0;
+    int h = 0;
+
+    bool operator==(const SpotRect &other) const = default;
+};
+
+// Immutable copy of everything the panel renders, handed across threads
+struct PanelState {
+    LookupData lookup;
+    SpotRect spot;
+    QString auxText;
+    QVector<TextAttribute> auxAttributes;
+    QString preeditText;
+    QVector<TextAttribute> preeditAttributes;
+    int preeditCaret = 0;
+    bool preeditVisible = false;
+    bool auxVisible = false;
+    bool lookupVisible = false;
+    bool enabled = false;
+    quint64 version = 0;
+};
+
+// Describes what a SetLookupTable call changed relative to the previous table
+struct LookupChange {
+    int previousCursor = -1;
+    int cursor = -1;
+    // Inclusive range of candidate indices whose label, text or comment changed
+    int firstChanged = -1;
+    int lastChanged = -1;
+    bool countChanged = false;
+    bool pageFlagsChanged = false;
+    bool layoutChanged = false;
+
+    bool cursorMoved() const { return previousCursor != cursor; }
+    bool hasTextChanges() const { return firstChanged >= 0; }
+    bool isEmpty() const {
+        return !cursorMoved() && !hasTextChanges() && !countChanged
+            && !pageFlagsChanged && !layoutChanged;
+    }
+
+    void markChanged(int index);
+    // Folds a later change into this one; the result describes both relative to
+    // the state before this change
+    void merge(const LookupChange &next);
+
+    static LookupChange all(int count, int cursor);
 };
 
-class KimpanelAdaptor : public QObject {
+class KimpanelAdaptor : public QObject, protected QDBusContext {
     Q_OBJECT
     Q_CLASSINFO("D-Bus Interface", "org.kde.impanel2")
     Q_PROPERTY(QStringList labels   READ labels   NOTIFY lookupChanged)
@@ -35,28 +100,27 @@ class KimpanelAdaptor : public QObject {
     Q_PROPERTY(bool auxVisible READ auxVisible NOTIFY auxChanged)
     Q_PROPERTY(bool lookupVisible READ lookupVisible NOTIFY lookupVisibleChanged)
     Q_PROPERTY(bool enabled READ enabled NOTIFY enabledChanged)
+    Q_PROPERTY(QString preeditText READ preeditText NOTIFY preeditChanged)
+    Q_PROPERTY(int preeditCaret READ preeditCaret NOTIFY preeditChanged)
+    Q_PROPERTY(bool preeditVisible READ preeditVisible NOTIFY preeditChanged)
 
 public:
-    struct Property {
-        QString key;
-        QString label;
-        QString icon;
-        QString tip;
-        QString hint;
-
-        bool operator==(const Property &other) const = default;
-        bool isValid() const { return !key.isEmpty(); }
-    };
+    using Property = PanelProperty;
 
     explicit KimpanelAdaptor(QObject *parent=nullptr);
 
     // Expose to QML
-    QStringList labels()   const { return data_.labels; }
-    QStringList texts()    const { return data_.texts; }
-    QStringList comments() const { return data_.comments; }
+    const QStringList &labels()   const { return data_.labels; }
+    const QStringList &texts()    const { return data_.texts; }
+    const QStringList &comments() const { return data_.comments; }
+    // Read-only views for per-update consumers; valid until the next SetLookupTable
+    std::span<const QString> labelsView()   const { return {data_.labels.constData(), size_t(data_.labels.size())}; }
+    std::span<const QString> textsView()    const { return {data_.texts.constData(), size_t(data_.texts.size())}; }
+    std::span<const QString> commentsView() const { return {data_.comments.constData(), size_t(data_.comments.size())}; }
     bool hasPrev() const { return data_.hasPrev; }
     bool hasNext() const { return data_.hasNext; }
     int cursor()   const { return data_.cursor; }
+    int layout()   const { return data_.layout; }
 
     int spotX() const { return spot_.x; }
     int spotY() const { return spot_.y; }
@@ -68,18 +132,38 @@ public:
     bool auxVisible() const { return auxVisible_; }
     bool lookupVisible() const { return lookupVisible_; }
     bool enabled() const { return enabled_; }
-
-    const QVector<Property> &properties() const { return properties_; }
+    const QVector<TextAttribute> &auxAttributes() const { return auxAttributes_; }
+    QString preeditText() const { return preeditText_; }
+    const QVector<TextAttribute> &preeditAttributes() const { return preeditAttributes_; }
+    // Code point offset into preeditText()
+    int preeditCaret() const { return preeditCaret_; }
+    bool preeditVisible() const { return preeditVisible_; }
+
+    // Heap allocations made by the most recent SetLookupTable (KIMPANEL_ALLOC_STATS builds)
+    quint64 lastLookupAllocations() const { return lastLookupAllocations_; }
+    // Sum over all SetLookupTable calls, for per-update figures
+    quint64 lookupAllocations() const { return lookupAllocations_; }
+
+    const QVector<Property> &properties() const { return properties_.items(); }
     std::optional<Property> propertyForKey(const QString &key) const;
+    // O(1); the pointer is valid until the next property update
+    const Property *findProperty(const QString &key) const { return properties_.find(key); }
 
     void triggerProperty(const QString &key);
+    // Connection used for outgoing org.kde.impanel signals; defaults to the session bus
+    void setConnection(const QDBusConnection &bus) { bus_ = bus; }
+
+    PanelState snapshot() const;
+    // Brings this adaptor to the given state, emitting the usual change signals
+    void applySnapshot(const PanelState &state);
 
 public slots:
     // org.kde.impanel2
     void SetSpotRect(int x, int y, int w, int h);
-    void SetLookupTable(const QStringList &labels,
-                        const QStringList &texts,
-                        const QStringList &comments,
+    // Lists are taken by value so the demarshalled storage is adopted, not copied
+    void SetLookupTable(QStringList labels,
+                        QStringList texts,
+                        QStringList comments,
                         bool hasPrev, bool hasNext,
                         int cursor, int layout);
 
@@ -88,6 +172,11 @@ public slots:
     void setAuxVisible(bool v) { if (auxVisible_ == v) return; auxVisible_ = v; emit auxChanged(); }
     void setLookupVisible(bool v) { if (lookupVisible_ == v) return; lookupVisible_ = v; emit lookupVisibleChanged(); }
     void setEnabled(bool v) { if (enabled_ == v) return; enabled_ = v; emit enabledChanged(); }
+    void setAuxAttributes(const QString &attr);
+    void setPreeditText(const QString &text, const QString &attr);
+    void setPreeditCaret(int caret) { if (preeditCaret_ == caret) return; preeditCaret_ = caret; emit preeditChanged(); }
+    void setPreeditVisible(bool v) { if (preeditVisible_ == v) return; preeditVisible_ = v; emit preeditChanged(); }
+    void setLookupCursor(int cursor);
 
     void handleRegisterProperties(const QStringList &props);
     void handleUpdateProperty(const QString &prop);
@@ -96,23 +185,34 @@ public slots:
 
 signals:
     void lookupChanged();
+    void lookupTableChanged(const LookupChange &change);
     void spotChanged();
     void auxChanged();
     void lookupVisibleChanged();
     void enabledChanged();
-    void propertiesChanged();
-    void propertyChanged(const QString &key);
+    void preeditChanged();
+    // Emitted once per RegisterProperties/UpdateProperty/RemoveProperty that changed something
+    void propertiesUpdated(const PropertyChangeSet &changes);
     void execMenuReceived(const QVector<Property> &entries);
 
 private:
-    int propertyIndex(const QString &key) const;
+    // Hands the incoming org.kde.impanel2 call to an active --record capture
+    void recordCall(const char *member);
 
+    QDBusConnection bus_ = QDBusConnection::sessionBus();
     LookupData data_;
-    struct { int x=0,y=0,w=0,h=0; } spot_;
+    quint64 lastLookupAllocations_ = 0;
+    quint64 lookupAllocations_ = 0;
+    SpotRect spot_;
     // inputmethod state
     QString auxText_;
+    QVector<TextAttribute> auxAttributes_;
+    QString preeditText_;
+    QVector<TextAttribute> preeditAttributes_;
+    int preeditCaret_ = 0;
+    bool preeditVisible_ = false;
     bool auxVisible_ = false;
     bool lookupVisible_ = false;
     bool enabled_ = false;
-    QVector<Property> properties_;
+    PropertyStore properties_;
 };
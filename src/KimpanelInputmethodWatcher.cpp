@@ -1,12 +1,61 @@
 #include "KimpanelInputmethodWatcher.h"
+#include "BusTrace.h"
 #include "KimpanelAdaptor.h"
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusServiceWatcher>
 #include <QDebug>
 #include <QProcessEnvironment>
+#include <QVector>
 
+static const char* INPUTMETHOD_SERVICE = "org.kde.kimpanel.inputmethod";
 static const char* INPUTMETHOD_IFACE = "org.kde.kimpanel.inputmethod";
+// Object path fcitx emits the kimpanel signals from; KIMPANEL_INPUTMETHOD_PATH
+// overrides it, an empty value matches any path
+static const char* INPUTMETHOD_PATH = "/kimpanel";
+
+namespace {
+struct SignalBinding {
+    const char *member;
+    const char *slot;
+    KimpanelInputmethodWatcher::Subscription group;
+};
+
+const QVector<SignalBinding> &signalBindings() {
+    static const QVector<SignalBinding> bindings = {
+        // Show/Hide states
+        {"ShowAux", SLOT(onShowAux(bool)), KimpanelInputmethodWatcher::StateSignals},
+        {"ShowLookupTable", SLOT(onShowLookupTable(bool)), KimpanelInputmethodWatcher::StateSignals},
+        {"Enable", SLOT(onEnable(bool)), KimpanelInputmethodWatcher::StateSignals},
+        {"ShowPreedit", SLOT(onShowPreedit(bool)), KimpanelInputmethodWatcher::StateSignals},
+        // Text updates
+        {"UpdateAux", SLOT(onUpdateAux(QString, QString)), KimpanelInputmethodWatcher::StateSignals},
+        {"UpdatePreeditText", SLOT(onUpdatePreeditText(QString, QString)), KimpanelInputmethodWatcher::StateSignals},
+        {"UpdatePreeditCaret", SLOT(onUpdatePreeditCaret(int)), KimpanelInputmethodWatcher::StateSignals},
+        {"UpdateSpotLocation", SLOT(onUpdateSpotLocation(int, int)), KimpanelInputmethodWatcher::StateSignals},
+        // Lookup table for engines that do not use org.kde.impanel2.SetLookupTable
+        {"UpdateLookupTable", SLOT(onUpdateLookupTable(QStringList, QStringList, QStringList, bool, bool)),
+         KimpanelInputmethodWatcher::StateSignals},
+        {"UpdateLookupTableCursor", SLOT(onUpdateLookupTableCursor(int)), KimpanelInputmethodWatcher::StateSignals},
+        // Property registration for status area / tray integration
+        {"RegisterProperties", SLOT(onRegisterProperties(QStringList)), KimpanelInputmethodWatcher::PropertySignals},
+        {"UpdateProperty", SLOT(onUpdateProperty(QString)), KimpanelInputmethodWatcher::PropertySignals},
+        {"RemoveProperty", SLOT(onRemoveProperty(QString)), KimpanelInputmethodWatcher::PropertySignals},
+        {"ExecMenu", SLOT(onExecMenu(QStringList)), KimpanelInputmethodWatcher::PropertySignals},
+    };
+    return bindings;
+}
+}
 
 KimpanelInputmethodWatcher::KimpanelInputmethodWatcher(KimpanelAdaptor* adaptor, QObject* parent)
-    : QObject(parent), adaptor_(adaptor) {
+    : KimpanelInputmethodWatcher(adaptor, QDBusConnection::sessionBus(), AllSignals, parent) {}
+
+KimpanelInputmethodWatcher::KimpanelInputmethodWatcher(KimpanelAdaptor* adaptor,
+                                                       const QDBusConnection &bus,
+                                                       Subscriptions subscriptions,
+                                                       QObject* parent)
+    : QObject(parent), adaptor_(adaptor), bus_(bus), subscriptions_(subscriptions) {
     if (!adaptor_) return;
 
     const bool disabled = qEnvironmentVariableIsSet("KIMPANEL_DISABLE_INPUTMETHOD");
@@ -14,81 +63,170 @@ KimpanelInputmethodWatcher::KimpanelInputmethodWatcher(KimpanelAdaptor* adaptor,
         qDebug() << "[DBUS][inputmethod] Disabled by env KIMPANEL_DISABLE_INPUTMETHOD";
         return;
     }
-    subscribe();
+
+    path_ = qEnvironmentVariableIsSet("KIMPANEL_INPUTMETHOD_PATH")
+        ? qEnvironmentVariable("KIMPANEL_INPUTMETHOD_PATH")
+        : QString::fromLatin1(INPUTMETHOD_PATH);
+
+    ownerWatcher_ = new QDBusServiceWatcher(QString::fromLatin1(INPUTMETHOD_SERVICE), bus_,
+                                            QDBusServiceWatcher::WatchForOwnerChange, this);
+    connect(ownerWatcher_, &QDBusServiceWatcher::serviceOwnerChanged,
+            this, &KimpanelInputmethodWatcher::onEngineOwnerChanged);
+    queryEngineOwner();
 }
 
-void KimpanelInputmethodWatcher::subscribe() {
-    auto bus = QDBusConnection::sessionBus();
+void KimpanelInputmethodWatcher::queryEngineOwner() {
+    auto msg = QDBusMessage::createMethodCall(QStringLiteral("org.freedesktop.DBus"),
+                                              QStringLiteral("/org/freedesktop/DBus"),
+                                              QStringLiteral("org.freedesktop.DBus"),
+                                              QStringLiteral("GetNameOwner"));
+    msg << QString::fromLatin1(INPUTMETHOD_SERVICE);
+    auto *call = new QDBusPendingCallWatcher(bus_.asyncCall(msg), this);
+    connect(call, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *call) {
+        const QDBusPendingReply<QString> reply = *call;
+        call->deleteLater();
+        // A NameOwnerChanged that arrived first is more recent than this reply
+        if (reply.isError() || !owner_.isEmpty()) {
+            return;
+        }
+        setEngineOwner(reply.value());
+    });
+}
 
-    // Show/Hide states
-    bus.connect(QString(), QString(), INPUTMETHOD_IFACE, QStringLiteral("ShowAux"),
-                this, SLOT(onShowAux(bool)));
-    bus.connect(QString(), QString(), INPUTMETHOD_IFACE, QStringLiteral("ShowLookupTable"),
-                this, SLOT(onShowLookupTable(bool)));
-    bus.connect(QString(), QString(), INPUTMETHOD_IFACE, QStringLiteral("Enable"),
-                this, SLOT(onEnable(bool)));
+void KimpanelInputmethodWatcher::onEngineOwnerChanged(const QString &service,
+                                                      const QString &oldOwner,
+                                                      const QString &newOwner) {
+    Q_UNUSED(service);
+    Q_UNUSED(oldOwner);
+    setEngineOwner(newOwner);
+}
 
-    // Text updates (attributes ignored initially)
-    bus.connect(QString(), QString(), INPUTMETHOD_IFACE, QStringLiteral("UpdateAux"),
-                this, SLOT(onUpdateAux(QString, QString)));
+void KimpanelInputmethodWatcher::setEngineOwner(const QString &owner) {
+    if (owner == owner_) {
+        return;
+    }
+    if (!owner_.isEmpty()) {
+        applyMatchRules(owner_, false);
+    }
+    owner_ = owner;
+    ++stats_.ownerChanges;
+    if (!owner_.isEmpty()) {
+        applyMatchRules(owner_, true);
+    }
+    qDebug() << "[DBUS][inputmethod] Engine owner is now" << (owner_.isEmpty() ? QStringLiteral("<none>") : owner_);
+}
 
-    // Property registration for status area / tray integration
-    bus.connect(QString(), QString(), INPUTMETHOD_IFACE, QStringLiteral("RegisterProperties"),
-                this, SLOT(onRegisterProperties(QStringList)));
-    bus.connect(QString(), QString(), INPUTMETHOD_IFACE, QStringLiteral("UpdateProperty"),
-                this, SLOT(onUpdateProperty(QString)));
-    bus.connect(QString(), QString(), INPUTMETHOD_IFACE, QStringLiteral("RemoveProperty"),
-                this, SLOT(onRemoveProperty(QString)));
-    bus.connect(QString(), QString(), INPUTMETHOD_IFACE, QStringLiteral("ExecMenu"),
-                this, SLOT(onExecMenu(QStringList)));
+void KimpanelInputmethodWatcher::applyMatchRules(const QString &owner, bool add) {
+    for (const auto &binding : signalBindings()) {
+        if (!(subscriptions_ & binding.group)) {
+            continue;
+        }
+        const QString member = QString::fromLatin1(binding.member);
+        if (add) {
+            bus_.connect(owner, path_, INPUTMETHOD_IFACE, member, this, binding.slot);
+        } else {
+            bus_.disconnect(owner, path_, INPUTMETHOD_IFACE, member, this, binding.slot);
+        }
+    }
+    if (add) {
+        qDebug() << "[DBUS][inputmethod] Subscribed to" << INPUTMETHOD_IFACE << "signals from" << owner << "on" << bus_.name();
+    }
+}
 
-    qDebug() << "[DBUS][inputmethod] Subscribed to" << INPUTMETHOD_IFACE << "signals";
+bool KimpanelInputmethodWatcher::accept() {
+    ++stats_.received;
+    if (!adaptor_) {
+        return false;
+    }
+    // Rules are sender-scoped; this only filters deliveries racing an owner change
+    if (calledFromDBus() && message().service() != owner_) {
+        return false;
+    }
+    ++stats_.handled;
+    if (BusTraceRecorder *recorder = BusTraceRecorder::active(); recorder && calledFromDBus()) {
+        recorder->record(BusTrace::Source::InputmethodSignal, message());
+    }
+    return true;
 }
 
 void KimpanelInputmethodWatcher::onUpdateAux(const QString &text, const QString &attr) {
-    Q_UNUSED(attr);
-    if (!adaptor_) return;
+    if (!accept()) return;
     adaptor_->setAuxText(text);
+    adaptor_->setAuxAttributes(attr);
 }
 
 void KimpanelInputmethodWatcher::onShowAux(bool visible) {
-    if (!adaptor_) return;
+    if (!accept()) return;
     adaptor_->setAuxVisible(visible);
 }
 
 void KimpanelInputmethodWatcher::onShowLookupTable(bool visible) {
-    if (!adaptor_) return;
+    if (!accept()) return;
     adaptor_->setLookupVisible(visible);
 }
 
 void KimpanelInputmethodWatcher::onEnable(bool enabled) {
-    if (!adaptor_) return;
+    if (!accept()) return;
     adaptor_->setEnabled(enabled);
 }
 
+void KimpanelInputmethodWatcher::onUpdatePreeditText(const QString &text, const QString &attr) {
+    if (!accept()) return;
+    adaptor_->setPreeditText(text, attr);
+}
+
+void KimpanelInputmethodWatcher::onUpdatePreeditCaret(int position) {
+    if (!accept()) return;
+    adaptor_->setPreeditCaret(position);
+}
+
+void KimpanelInputmethodWatcher::onShowPreedit(bool visible) {
+    if (!accept()) return;
+    adaptor_->setPreeditVisible(visible);
+}
+
+void KimpanelInputmethodWatcher::onUpdateSpotLocation(int x, int y) {
+    if (!accept()) return;
+    adaptor_->SetSpotRect(x, y, 0, 0);
+}
+
+void KimpanelInputmethodWatcher::onUpdateLookupTable(const QStringList &labels, const QStringList &texts,
+                                                     const QStringList &attrs, bool hasPrev, bool hasNext) {
+    // Per-candidate attribute strings have no rendering in the candidate row
+    Q_UNUSED(attrs);
+    if (!accept()) return;
+    adaptor_->SetLookupTable(labels, texts, QStringList(), hasPrev, hasNext,
+                             adaptor_->cursor(), adaptor_->layout());
+}
+
+void KimpanelInputmethodWatcher::onUpdateLookupTableCursor(int cursor) {
+    if (!accept()) return;
+    adaptor_->setLookupCursor(cursor);
+}
+
 void KimpanelInputmethodWatcher::onRegisterProperties(const QStringList &props) {
-    if (!adaptor_) {
+    if (!accept()) {
         return;
     }
     adaptor_->handleRegisterProperties(props);
 }
 
 void KimpanelInputmethodWatcher::onUpdateProperty(const QString &prop) {
-    if (!adaptor_) {
+    if (!accept()) {
         return;
     }
     adaptor_->handleUpdateProperty(prop);
 }
 
 void KimpanelInputmethodWatcher::onRemoveProperty(const QString &key) {
-    if (!adaptor_) {
+    if (!accept()) {
         return;
     }
     adaptor_->handleRemoveProperty(key);
 }
 
 void KimpanelInputmethodWatcher::onExecMenu(const QStringList &entries) {
-    if (!adaptor_) {
+    if (!accept()) {
         return;
     }
     adaptor_->handleExecMenu(entries);
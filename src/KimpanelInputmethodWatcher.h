@@ -2,27 +2,73 @@
 
 #include <QObject>
 #include <QDBusConnection>
+#include <QDBusContext>
 #include <QStringList>
 
 class KimpanelAdaptor;
+class QDBusServiceWatcher;
 
-// Listens to org.kde.kimpanel.inputmethod signals and updates adaptor state
-class KimpanelInputmethodWatcher : public QObject {
+// Listens to org.kde.kimpanel.inputmethod signals and updates adaptor state.
+// Match rules are scoped to the unique name currently owning the inputmethod
+// service, so the bus daemon does not route other peers' emissions to us.
+class KimpanelInputmethodWatcher : public QObject, protected QDBusContext {
     Q_OBJECT
 public:
+    enum Subscription {
+        // Enable, Show*/Update* aux, preedit, lookup table and spot: per-keystroke panel state
+        StateSignals = 0x1,
+        // RegisterProperties/UpdateProperty/RemoveProperty/ExecMenu: tray and menus
+        PropertySignals = 0x2,
+        AllSignals = StateSignals | PropertySignals,
+    };
+    Q_DECLARE_FLAGS(Subscriptions, Subscription)
+
+    struct Stats {
+        quint64 received = 0;
+        quint64 handled = 0;
+        quint64 ownerChanges = 0;
+    };
+
     explicit KimpanelInputmethodWatcher(KimpanelAdaptor* adaptor, QObject* parent = nullptr);
+    KimpanelInputmethodWatcher(KimpanelAdaptor* adaptor,
+                               const QDBusConnection &bus,
+                               Subscriptions subscriptions,
+                               QObject* parent = nullptr);
+
+    const Stats &stats() const { return stats_; }
+    QString engineOwner() const { return owner_; }
 
 private slots:
     void onUpdateAux(const QString &text, const QString &attr);
     void onShowAux(bool visible);
     void onShowLookupTable(bool visible);
     void onEnable(bool enabled);
+    void onUpdatePreeditText(const QString &text, const QString &attr);
+    void onUpdatePreeditCaret(int position);
+    void onShowPreedit(bool visible);
+    void onUpdateSpotLocation(int x, int y);
+    void onUpdateLookupTable(const QStringList &labels, const QStringList &texts,
+                             const QStringList &attrs, bool hasPrev, bool hasNext);
+    void onUpdateLookupTableCursor(int cursor);
     void onRegisterProperties(const QStringList &props);
     void onUpdateProperty(const QString &prop);
     void onRemoveProperty(const QString &key);
     void onExecMenu(const QStringList &entries);
+    void onEngineOwnerChanged(const QString &service, const QString &oldOwner, const QString &newOwner);
 
 private:
-    void subscribe();
+    void queryEngineOwner();
+    void setEngineOwner(const QString &owner);
+    void applyMatchRules(const QString &owner, bool add);
+    bool accept();
+
     KimpanelAdaptor* adaptor_ = nullptr;
+    QDBusConnection bus_;
+    Subscriptions subscriptions_ = AllSignals;
+    QDBusServiceWatcher *ownerWatcher_ = nullptr;
+    QString owner_;
+    QString path_;
+    Stats stats_;
 };
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(KimpanelInputmethodWatcher::Subscriptions)
@@ -0,0 +1,161 @@
+#include "LatencyTracker.h"
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <bit>
+
+namespace {
+QElapsedTimer &processClock() {
+    static QElapsedTimer clock = []() {
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+    return clock;
+}
+
+int bucketFor(qint64 us) {
+    if (us < 1) {
+        return 0;
+    }
+    const auto value = static_cast<quint64>(us);
+    const int exponent = 63 - std::countl_zero(value);
+    // Sub-bucket from the bits below the leading one
+    const int sub = exponent >= 3
+        ? static_cast<int>((value >> (exponent - 3)) & 0x7)
+        : static_cast<int>((value << (3 - exponent)) & 0x7);
+    return std::min(exponent * 8 + sub, 32 * 8 - 1);
+}
+
+qint64 bucketUpperBound(int bucket) {
+    const int exponent = bucket / 8;
+    const int sub = bucket % 8;
+    const double base = double(quint64(1) << exponent);
+    return static_cast<qint64>(base + base * (sub + 1) / 8.0);
+}
+}
+
+LatencyTracker &LatencyTracker::instance() {
+    static LatencyTracker tracker;
+    return tracker;
+}
+
+qint64 LatencyTracker::now() {
+    // Offset by one so a valid timestamp is never 0
+    return processClock().nsecsElapsed() + 1;
+}
+
+const char *LatencyTracker::stageName(Stage stage) {
+    switch (stage) {
+    case ReceiptToCommit: return "receipt-to-commit";
+    case CommitToLayout: return "commit-to-layout";
+    case LayoutToPaint: return "layout-to-paint";
+    case PaintToFlush: return "paint-to-flush";
+    case ReceiptToFlush: return "receipt-to-flush";
+    case StageCount: break;
+    }
+    return "unknown";
+}
+
+void LatencyTracker::markReceipt(qint64 at) {
+    qint64 expected = 0;
+    pendingReceipt_.compare_exchange_strong(expected, at, std::memory_order_acq_rel);
+}
+
+void LatencyTracker::markCommit() {
+    const qint64 receipt = pendingReceipt_.exchange(0, std::memory_order_acq_rel);
+    if (!receipt) {
+        return;
+    }
+    // A previous cycle that never reached the screen only reports its early stages
+    finishCycle();
+    cycle_.receipt = receipt;
+    cycle_.commit = now();
+    record(ReceiptToCommit, cycle_.receipt, cycle_.commit);
+}
+
+void LatencyTracker::markLayout() {
+    if (!cycle_.commit || cycle_.layout) {
+        return;
+    }
+    cycle_.layout = now();
+    record(CommitToLayout, cycle_.commit, cycle_.layout);
+}
+
+void LatencyTracker::markPaint() {
+    if (!cycle_.layout || cycle_.paint) {
+        return;
+    }
+    cycle_.paint = now();
+    record(LayoutToPaint, cycle_.layout, cycle_.paint);
+}
+
+void LatencyTracker::markFlush() {
+    if (!cycle_.layout) {
+        return;
+    }
+    const qint64 flush = now();
+    // Only children may have been repainted; the end-to-end figure still holds
+    if (cycle_.paint) {
+        record(PaintToFlush, cycle_.paint, flush);
+    }
+    record(ReceiptToFlush, cycle_.receipt, flush);
+    cycle_ = Cycle();
+}
+
+void LatencyTracker::finishCycle() {
+    cycle_ = Cycle();
+}
+
+void LatencyTracker::record(Stage stage, qint64 fromNs, qint64 toNs) {
+    histograms_[stage].add(std::max<qint64>(toNs - fromNs, 0) / 1000);
+}
+
+LatencyTracker::Summary LatencyTracker::summary(Stage stage) const {
+    const Histogram &histogram = histograms_[stage];
+    Summary summary;
+    summary.count = histogram.count;
+    summary.p50Us = histogram.percentile(0.50);
+    summary.p99Us = histogram.percentile(0.99);
+    summary.maxUs = histogram.maxUs;
+    return summary;
+}
+
+QStringList LatencyTracker::report() const {
+    QStringList lines;
+    for (int stage = 0; stage < StageCount; ++stage) {
+        const Summary s = summary(static_cast<Stage>(stage));
+        if (!s.count) {
+            continue;
+        }
+        lines << QStringLiteral("%1 count=%2 p50=%3us p99=%4us max=%5us")
+                     .arg(QString::fromLatin1(stageName(static_cast<Stage>(stage))))
+                     .arg(s.count)
+                     .arg(s.p50Us)
+                     .arg(s.p99Us)
+                     .arg(s.maxUs);
+    }
+    return lines;
+}
+
+void LatencyTracker::Histogram::add(qint64 us) {
+    ++buckets[bucketFor(us)];
+    ++count;
+    maxUs = std::max(maxUs, us);
+}
+
+qint64 LatencyTracker::Histogram::percentile(double fraction) const {
+    if (!count) {
+        return 0;
+    }
+    const quint64 rank = std::max<quint64>(1, static_cast<quint64>(fraction * double(count) + 0.5));
+    quint64 seen = 0;
+    for (int bucket = 0; bucket < BUCKETS; ++bucket) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            return std::min(bucketUpperBound(bucket), maxUs);
+        }
+    }
+    return maxUs;
+}
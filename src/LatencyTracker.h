@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QStringList>
+
+#include <array>
+#include <atomic>
+
+// Keystroke-to-pixels latency of the candidate panel. Timestamps are taken when
+// SetLookupTable reaches the adaptor, when the panel commits the state, after
+// layout, after paint and after the backing store flush; each stage feeds a
+// log-linear histogram that reports p50/p99/max.
+class LatencyTracker {
+public:
+    enum Stage {
+        ReceiptToCommit,
+        CommitToLayout,
+        LayoutToPaint,
+        PaintToFlush,
+        ReceiptToFlush,
+        StageCount,
+    };
+
+    static LatencyTracker &instance();
+
+    // Monotonic process clock shared by all marks
+    static qint64 now();
+
+    // May be called from any thread; the first receipt since the last commit wins
+    void markReceipt(qint64 at);
+    // GUI thread only
+    void markCommit();
+    void markLayout();
+    void markPaint();
+    void markFlush();
+
+    struct Summary {
+        quint64 count = 0;
+        qint64 p50Us = 0;
+        qint64 p99Us = 0;
+        qint64 maxUs = 0;
+    };
+    Summary summary(Stage stage) const;
+    // One line per stage with samples
+    QStringList report() const;
+
+    static const char *stageName(Stage stage);
+
+private:
+    // 8 sub-buckets per power of two of microseconds, up to ~2^31 us
+    static constexpr int SUB_BUCKETS = 8;
+    static constexpr int BUCKETS = 32 * SUB_BUCKETS;
+
+    struct Histogram {
+        std::array<quint64, BUCKETS> buckets = {};
+        quint64 count = 0;
+        qint64 maxUs = 0;
+
+        void add(qint64 us);
+        qint64 percentile(double fraction) const;
+    };
+
+    void record(Stage stage, qint64 fromNs, qint64 toNs);
+    void finishCycle();
+
+    std::atomic<qint64> pendingReceipt_{0};
+    struct Cycle {
+        qint64 receipt = 0;
+        qint64 commit = 0;
+        qint64 layout = 0;
+        qint64 paint = 0;
+    } cycle_;
+    std::array<Histogram, StageCount> histograms_;
+};
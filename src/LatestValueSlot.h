@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <memory>
+
+// Single-producer/single-consumer mailbox that only keeps the newest value.
+// Publishing over an unconsumed value drops the older one; neither side blocks.
+template <typename T>
+class LatestValueSlot {
+public:
+    LatestValueSlot() = default;
+    LatestValueSlot(const LatestValueSlot &) = delete;
+    LatestValueSlot &operator=(const LatestValueSlot &) = delete;
+    ~LatestValueSlot() { delete slot_.exchange(nullptr, std::memory_order_acquire); }
+
+    // Returns true when the slot was empty, i.e. the consumer needs a wakeup.
+    // A replaced, never consumed value is destroyed here and counted as dropped.
+    bool publish(std::unique_ptr<T> value) {
+        T *previous = slot_.exchange(value.release(), std::memory_order_acq_rel);
+        if (previous) {
+            delete previous;
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    std::unique_ptr<T> take() {
+        return std::unique_ptr<T>(slot_.exchange(nullptr, std::memory_order_acq_rel));
+    }
+
+    quint64 dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<T*> slot_{nullptr};
+    std::atomic<quint64> dropped_{0};
+};
@@ -0,0 +1,62 @@
+#include "PanelHost.h"
+
+#include "KimpanelAdaptor.h"
+#include "PanelWindow.h"
+#include "StartupTimeline.h"
+#include "SystemTrayController.h"
+
+PanelHost::PanelHost(KimpanelAdaptor *adaptor, QObject *parent)
+    : QObject(parent), adaptor_(adaptor) {
+    idleTimer_.setSingleShot(true);
+    idleTimer_.setInterval(IDLE_BUILD_DELAY_MS);
+    connect(&idleTimer_, &QTimer::timeout, this, &PanelHost::buildWhenIdle);
+    idleTimer_.start();
+
+    if (!adaptor_) {
+        return;
+    }
+    // The panel reads the current state when built, so the triggering update is not lost
+    auto build = [this]() { ensurePanel(); };
+    panelTriggers_ << connect(adaptor_, &KimpanelAdaptor::lookupTableChanged, this, build)
+                   << connect(adaptor_, &KimpanelAdaptor::lookupVisibleChanged, this, build)
+                   << connect(adaptor_, &KimpanelAdaptor::auxChanged, this, build)
+                   << connect(adaptor_, &KimpanelAdaptor::preeditChanged, this, build);
+    trayTrigger_ = connect(adaptor_, &KimpanelAdaptor::propertiesUpdated, this, [this]() { ensureTray(); });
+}
+
+PanelHost::~PanelHost() = default;
+
+PanelWindow *PanelHost::ensurePanel() {
+    if (panel_) {
+        return panel_.get();
+    }
+    for (const QMetaObject::Connection &connection : std::as_const(panelTriggers_)) {
+        disconnect(connection);
+    }
+    panelTriggers_.clear();
+
+    panel_ = std::make_unique<PanelWindow>(adaptor_);
+    StartupTimeline::instance().mark(StartupTimeline::PanelCreated);
+    emit panelCreated(panel_.get());
+    return panel_.get();
+}
+
+SystemTrayController *PanelHost::ensureTray() {
+    if (tray_) {
+        return tray_.get();
+    }
+    disconnect(trayTrigger_);
+
+    tray_ = std::make_unique<SystemTrayController>(adaptor_);
+    StartupTimeline::instance().mark(StartupTimeline::TrayCreated);
+    return tray_.get();
+}
+
+void PanelHost::cycleInputMethod() {
+    ensureTray()->cycleInputMethod();
+}
+
+void PanelHost::buildWhenIdle() {
+    ensureTray();
+    ensurePanel();
+}
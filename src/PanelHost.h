@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QTimer>
+
+#include <memory>
+
+class KimpanelAdaptor;
+class PanelWindow;
+class SystemTrayController;
+
+// Owns the panel window and the tray icon and builds them off the startup
+// path: the panel when the engine first sends content, the tray when it first
+// registers properties, and otherwise IDLE_BUILD_DELAY_MS after startup.
+// Claiming the bus does not wait for DTK widgets, palettes or icon theme lookups.
+class PanelHost : public QObject {
+    Q_OBJECT
+public:
+    static constexpr int IDLE_BUILD_DELAY_MS = 300;
+
+    explicit PanelHost(KimpanelAdaptor *adaptor, QObject *parent = nullptr);
+    ~PanelHost() override;
+
+    // Null until built
+    PanelWindow *panel() const { return panel_.get(); }
+    PanelWindow *ensurePanel();
+    SystemTrayController *ensureTray();
+
+public slots:
+    void cycleInputMethod();
+
+signals:
+    void panelCreated(PanelWindow *panel);
+
+private:
+    void buildWhenIdle();
+
+    KimpanelAdaptor *adaptor_ = nullptr;
+    std::unique_ptr<PanelWindow> panel_;
+    std::unique_ptr<SystemTrayController> tray_;
+    QTimer idleTimer_;
+    QList<QMetaObject::Connection> panelTriggers_;
+    QMetaObject::Connection trayTrigger_;
+};
@@ -0,0 +1,25 @@
+#include "PanelSizer.h"
+
+int PanelSizer::bucketed(int width) {
+    if (width <= 0) {
+        return 0;
+    }
+    return (width + BUCKET - 1) / BUCKET * BUCKET;
+}
+
+QSize PanelSizer::settled(const QSize &hint) {
+    return QSize(bucketed(hint.width()), hint.height());
+}
+
+PanelSizer::Decision PanelSizer::decide(const QSize &hint, const QSize &current, bool visible) {
+    Decision decision;
+    const int wanted = bucketed(hint.width());
+    if (!visible || wanted > current.width() || current.width() - wanted > SHRINK_THRESHOLD) {
+        decision.size = QSize(wanted, hint.height());
+        return decision;
+    }
+    // Keep the width; the height follows the content since rows rarely change
+    decision.size = QSize(current.width(), hint.height());
+    decision.shrinkLater = wanted < current.width();
+    return decision;
+}
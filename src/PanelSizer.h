@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QSize>
+
+// Width policy for the panel top-level. Following the content exactly turns
+// nearly every keystroke into a window resize (ConfigureWindow, compositor and
+// backing store reallocation), so the width only grows, in BUCKET steps, while
+// typing. It shrinks at once when the content is narrower by more than
+// SHRINK_THRESHOLD, otherwise after SHRINK_DELAY_MS without growing.
+class PanelSizer {
+public:
+    static constexpr int BUCKET = 32;
+    static constexpr int SHRINK_THRESHOLD = 192;
+    static constexpr int SHRINK_DELAY_MS = 600;
+
+    struct Decision {
+        QSize size;
+        // The content is narrower than the window; shrink once it stays so
+        bool shrinkLater = false;
+    };
+
+    // hint is the exact size the content needs; a hidden window starts fresh
+    static Decision decide(const QSize &hint, const QSize &current, bool visible);
+    // Exact fit rounded up to the bucket, used when the shrink delay expires
+    static QSize settled(const QSize &hint);
+    static int bucketed(int width);
+};
@@ -0,0 +1,50 @@
+#include "PanelTheme.h"
+
+#include <DPaletteHelper>
+#include <DPalette>
+
+#include <QWidget>
+
+DWIDGET_USE_NAMESPACE
+
+PanelTheme PanelTheme::fromWidget(const QWidget *widget) {
+    const DPalette palette = DPaletteHelper::instance()->palette(widget);
+    PanelTheme theme;
+
+    QColor text = palette.color(DPalette::Text);
+    if (!text.isValid()) {
+        text = palette.color(DPalette::WindowText);
+    }
+    if (!text.isValid()) {
+        text = palette.color(DPalette::BrightText);
+    }
+    if (!text.isValid()) {
+        text = QColor(Qt::black);
+    }
+    QColor highlight = palette.color(DPalette::Highlight);
+    if (!highlight.isValid()) {
+        highlight = text;
+    }
+
+    theme.background = palette.color(QPalette::Window);
+    theme.border = palette.color(QPalette::Midlight);
+    theme.text = text;
+    theme.highlight = highlight;
+    theme.comment = palette.color(QPalette::Mid);
+
+    theme.labelFont = widget->font();
+    theme.candidateFont = widget->font();
+    theme.candidateFont.setWeight(QFont::DemiBold);
+    theme.auxFont = widget->font();
+    theme.auxFont.setWeight(QFont::Medium);
+
+    theme.candidatePalette = palette;
+    theme.candidatePalette.setColor(QPalette::WindowText, text);
+    theme.candidatePalette.setColor(QPalette::Text, text);
+    theme.candidatePalette.setColor(QPalette::Highlight, highlight);
+    theme.candidatePalette.setColor(QPalette::PlaceholderText, theme.comment);
+
+    theme.auxPalette = palette;
+    theme.auxPalette.setColor(QPalette::WindowText, palette.color(QPalette::Text));
+    return theme;
+}
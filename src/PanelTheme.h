@@ -0,0 +1,34 @@
+#pragma once
+
+#include <QColor>
+#include <QFont>
+#include <QPalette>
+
+class QWidget;
+
+// Colours, fonts and metrics of the candidate panel. PanelWindow computes it
+// once per palette or font change, hands it to every part and repaints once;
+// the panel has no stylesheet to re-resolve.
+struct PanelTheme {
+    QColor background;
+    QColor border;
+    QColor text;
+    QColor highlight;
+    QColor comment;
+
+    QFont labelFont;
+    QFont candidateFont;
+    QFont auxFont;
+
+    int frameRadius = 10;
+    int chipRadius = 6;
+    int borderWidth = 1;
+
+    // Candidate row: WindowText for labels and text, Highlight for the
+    // selected candidate, PlaceholderText for comments
+    QPalette candidatePalette;
+    // Aux string: WindowText is the text colour
+    QPalette auxPalette;
+
+    static PanelTheme fromWidget(const QWidget *widget);
+};
@@ -0,0 +1,125 @@
+#include "PanelUpdateScheduler.h"
+
+#include "AllocationCounter.h"
+#include "KimpanelAdaptor.h"
+#include "Trace.h"
+
+#include <QGuiApplication>
+#include <QScreen>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr int FALLBACK_FRAME_INTERVAL_MS = 16;
+}
+
+PanelUpdateScheduler::PanelUpdateScheduler(KimpanelAdaptor *adaptor, QObject *parent)
+    : QObject(parent) {
+    frameTimer_.setSingleShot(true);
+    frameTimer_.setTimerType(Qt::PreciseTimer);
+    connect(&frameTimer_, &QTimer::timeout, this, &PanelUpdateScheduler::commit);
+
+    if (!adaptor) {
+        return;
+    }
+
+    connect(adaptor, &KimpanelAdaptor::lookupTableChanged,
+            this, &PanelUpdateScheduler::markLookupChanged);
+    connect(adaptor, &KimpanelAdaptor::auxChanged, this, [this]() {
+        markDirty(AuxDirty | VisibilityDirty);
+    });
+    connect(adaptor, &KimpanelAdaptor::lookupVisibleChanged, this, [this]() {
+        markDirty(LookupDirty | VisibilityDirty);
+    });
+    connect(adaptor, &KimpanelAdaptor::enabledChanged, this, [this]() {
+        markDirty(VisibilityDirty);
+    });
+    connect(adaptor, &KimpanelAdaptor::preeditChanged, this, [this]() {
+        markDirty(PreeditDirty | VisibilityDirty);
+    });
+    connect(adaptor, &KimpanelAdaptor::spotChanged, this, [this]() {
+        markDirty(SpotDirty);
+    });
+}
+
+void PanelUpdateScheduler::markDirty(DirtyFlags flags) {
+    if (flags == NoneDirty) {
+        return;
+    }
+    pending_ |= flags;
+    ++pendingSignals_;
+
+    if (frameTimer_.isActive()) {
+        return;
+    }
+
+    // Commit at the start of the next frame slot; if the last commit is older
+    // than a frame, that slot is the next event loop iteration. While updates
+    // keep coming, slots follow the phase of the last presented frame, so a
+    // burst of caret moves lands once per vsync instead of drifting across it.
+    const int interval = frameIntervalMs();
+    int delay = 0;
+    if (sinceLastCommit_.isValid() && sinceLastCommit_.elapsed() < interval) {
+        if (sinceLastPresent_.isValid()) {
+            delay = interval - static_cast<int>(sinceLastPresent_.elapsed() % interval);
+        } else {
+            delay = interval - static_cast<int>(sinceLastCommit_.elapsed());
+        }
+    }
+    frameTimer_.start(std::clamp(delay, 0, interval));
+}
+
+void PanelUpdateScheduler::framePresented() {
+    sinceLastPresent_.start();
+}
+
+void PanelUpdateScheduler::markLookupChanged(const LookupChange &change) {
+    if (hasPendingLookup_) {
+        pendingLookup_.merge(change);
+    } else {
+        pendingLookup_ = change;
+        hasPendingLookup_ = true;
+    }
+    markDirty(LookupDirty | VisibilityDirty);
+}
+
+void PanelUpdateScheduler::flush() {
+    frameTimer_.stop();
+    commit();
+}
+
+void PanelUpdateScheduler::commit() {
+    if (pending_ == NoneDirty) {
+        return;
+    }
+    const DirtyFlags flags = pending_;
+    const int folded = pendingSignals_;
+    const LookupChange lookup = hasPendingLookup_ ? pendingLookup_ : LookupChange();
+    pending_ = NoneDirty;
+    pendingSignals_ = 0;
+    pendingLookup_ = LookupChange();
+    hasPendingLookup_ = false;
+
+    ++stats_.commits;
+    stats_.foldedSignals += static_cast<quint64>(folded);
+    stats_.lastCommitSignals = folded;
+    stats_.maxCommitSignals = std::max(stats_.maxCommitSignals, folded);
+    sinceLastCommit_.start();
+
+    const AllocationScope allocations;
+    emit commitRequested(flags, lookup, folded);
+    stats_.lastCommitAllocations = allocations.count();
+    stats_.commitAllocations += stats_.lastCommitAllocations;
+    KIMPANEL_TRACE(lcTraceCommit, "commit flags=%1 folded=%2 allocations=%3",
+                   static_cast<int>(flags), folded, stats_.lastCommitAllocations);
+}
+
+int PanelUpdateScheduler::frameIntervalMs() const {
+    const QScreen *screen = QGuiApplication::primaryScreen();
+    const qreal rate = screen ? screen->refreshRate() : 0.0;
+    if (rate <= 1.0) {
+        return FALLBACK_FRAME_INTERVAL_MS;
+    }
+    return std::max(1, static_cast<int>(std::lround(1000.0 / rate)));
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "KimpanelAdaptor.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+// Folds adaptor change notifications into a single panel commit per display frame
+class PanelUpdateScheduler : public QObject {
+    Q_OBJECT
+public:
+    enum DirtyFlag {
+        NoneDirty = 0x0,
+        LookupDirty = 0x1,
+        AuxDirty = 0x2,
+        VisibilityDirty = 0x4,
+        SpotDirty = 0x8,
+        PreeditDirty = 0x10,
+        AllDirty = LookupDirty | AuxDirty | VisibilityDirty | SpotDirty | PreeditDirty,
+    };
+    Q_DECLARE_FLAGS(DirtyFlags, DirtyFlag)
+
+    struct Stats {
+        quint64 commits = 0;
+        quint64 foldedSignals = 0;
+        int lastCommitSignals = 0;
+        int maxCommitSignals = 0;
+        // Heap allocations made while applying the last commit (KIMPANEL_ALLOC_STATS builds)
+        quint64 lastCommitAllocations = 0;
+        quint64 commitAllocations = 0;
+    };
+
+    explicit PanelUpdateScheduler(KimpanelAdaptor *adaptor, QObject *parent = nullptr);
+
+    void markDirty(DirtyFlags flags);
+    void markLookupChanged(const LookupChange &change);
+    // Applies any pending changes right away instead of waiting for the next frame
+    void flush();
+    // Called after the panel flushed a frame; later commits keep that frame's phase
+    void framePresented();
+
+    const Stats &stats() const { return stats_; }
+
+signals:
+    // Receivers apply content first, then size, then position. The lookup change
+    // is relative to the state at the previous commit.
+    void commitRequested(PanelUpdateScheduler::DirtyFlags flags,
+                         const LookupChange &lookup,
+                         int foldedSignals);
+
+private:
+    void commit();
+    int frameIntervalMs() const;
+
+    QTimer frameTimer_;
+    QElapsedTimer sinceLastCommit_;
+    QElapsedTimer sinceLastPresent_;
+    DirtyFlags pending_ = NoneDirty;
+    LookupChange pendingLookup_;
+    bool hasPendingLookup_ = false;
+    int pendingSignals_ = 0;
+    Stats stats_;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(PanelUpdateScheduler::DirtyFlags)
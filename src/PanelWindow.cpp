@@ -1,43 +1,76 @@
 #include "PanelWindow.h"
 
+#include "AttributedTextView.h"
+#include "CandidateStrip.h"
+#include "GlyphPrewarmer.h"
 #include "KimpanelAdaptor.h"
+#include "LatencyTracker.h"
+#include "PanelTheme.h"
+#include "ScreenIndex.h"
+#include "StartupTimeline.h"
+#include "Trace.h"
 
-#include <DFrame>
 #include <DLabel>
-#include <DPaletteHelper>
-#include <DPalette>
 
 #include <QColor>
 #include <QDebug>
 #include <QEvent>
 #include <QFont>
-#include <QGuiApplication>
 #include <QHBoxLayout>
+#include <QPaintEvent>
+#include <QPainter>
 #include <QPalette>
+#include <QPen>
 #include <QPoint>
 #include <QPointF>
 #include <QRect>
 #include <QRectF>
+#include <QRegion>
 #include <QSizeF>
-#include <QScreen>
 #include <QSizePolicy>
-#include <QStyle>
+#include <QTimer>
 #include <QVBoxLayout>
 #include <QWidget>
 #include <algorithm>
 #include <cmath>
 #include <limits>
+#include <span>
 
 DWIDGET_USE_NAMESPACE
 
 namespace {
+// Left of and above any real screen; X11 coordinates are 16 bit
+constexpr int PARKED_X = -32000;
+constexpr int PARKED_Y = -32000;
+
+// Rounded, bordered background drawn from the shared theme
+class RoundedFrame : public QWidget {
+public:
+    RoundedFrame(const PanelTheme &theme, int PanelTheme::*radius, QWidget *parent)
+        : QWidget(parent), theme_(theme), radius_(radius) {}
+
+protected:
+    void paintEvent(QPaintEvent *) override {
+        QPainter painter(this);
+        painter.setRenderHint(QPainter::Antialiasing);
+        const qreal inset = theme_.borderWidth / 2.0;
+        painter.setPen(QPen(theme_.border, theme_.borderWidth));
+        painter.setBrush(theme_.background);
+        const qreal radius = theme_.*radius_;
+        painter.drawRoundedRect(QRectF(rect()).adjusted(inset, inset, -inset, -inset), radius, radius);
+    }
+
+private:
+    const PanelTheme &theme_;
+    int PanelTheme::*radius_;
+};
+
 class CandidateChip : public QWidget {
     Q_OBJECT
 public:
     explicit CandidateChip(QWidget *parent = nullptr)
         : QWidget(parent) {
         setObjectName("CandidateChip");
-        setAttribute(Qt::WA_StyledBackground, true);
         setAutoFillBackground(false);
 
         auto *layout = new QHBoxLayout(this);
@@ -64,13 +97,12 @@ public:
 
         comment_ = new DLabel(this);
         comment_->setObjectName("candidateComment");
+        comment_->setForegroundRole(QPalette::PlaceholderText);
         comment_->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
         comment_->setVisible(false);
         comment_->setSizePolicy(QSizePolicy::Maximum, QSizePolicy::Preferred);
         comment_->setWordWrap(false);
         layout->addWidget(comment_);
-
-        refreshPalette();
     }
 
     void setCandidate(const QString &label, const QString &text, const QString &comment) {
@@ -81,71 +113,21 @@ public:
         comment_->setVisible(!comment.isEmpty());
     }
 
+    // Colours come from the row palette set once per theme change; switching
+    // the role only repaints the two labels, with no palette lookup or repolish
     void setSelected(bool selected) {
         if (selected_ == selected) {
             return;
         }
         selected_ = selected;
-        setProperty("selected", selected);
-        refreshPalette();
-        style()->unpolish(this);
-        style()->polish(this);
-        update();
+        const QPalette::ColorRole role = selected ? QPalette::Highlight : QPalette::WindowText;
+        label_->setForegroundRole(role);
+        text_->setForegroundRole(role);
+        label_->update();
+        text_->update();
     }
 
 private:
-    void refreshPalette() {
-        auto helper = DPaletteHelper::instance();
-        DPalette palette = helper->palette(this);
-
-        QColor primaryText = palette.color(DPalette::Text);
-        if (!primaryText.isValid()) {
-            primaryText = palette.color(DPalette::WindowText);
-        }
-        if (!primaryText.isValid()) {
-            primaryText = palette.color(DPalette::BrightText);
-        }
-        if (!primaryText.isValid()) {
-            primaryText = QColor(Qt::black);
-        }
-
-        QColor secondaryText = palette.color(DPalette::PlaceholderText);
-        if (!secondaryText.isValid()) {
-            secondaryText = primaryText.darker(135);
-        }
-
-        QColor highlight = palette.color(DPalette::Highlight);
-        if (!highlight.isValid()) {
-            highlight = primaryText;
-        }
-
-        auto setLabelColor = [](DLabel *label, const QColor &color) {
-            if (!label) {
-                return;
-            }
-            auto pal = label->palette();
-            pal.setColor(QPalette::WindowText, color);
-            pal.setColor(QPalette::Text, color);
-            label->setPalette(pal);
-        };
-
-        const QColor labelColor = selected_ ? highlight : primaryText;
-        setLabelColor(label_, labelColor);
-        setLabelColor(text_, selected_ ? highlight : primaryText);
-        setLabelColor(comment_, secondaryText);
-    }
-
-    void changeEvent(QEvent *event) override {
-        QWidget::changeEvent(event);
-        if (!event) {
-            return;
-        }
-        const QEvent::Type type = event->type();
-        if (type == QEvent::PaletteChange || type == QEvent::ApplicationPaletteChange) {
-            refreshPalette();
-        }
-    }
-
     DLabel *label_ = nullptr;
     DLabel *text_ = nullptr;
     DLabel *comment_ = nullptr;
@@ -160,10 +142,29 @@ PanelWindow::PanelWindow(KimpanelAdaptor *adaptor, QWidget *parent)
     setWindowFlag(Qt::WindowStaysOnTopHint);
     setWindowFlag(Qt::WindowDoesNotAcceptFocus);
     setAttribute(Qt::WA_TranslucentBackground, true);
+    persistentSurface_ = persistentSurfaceRequested();
+
+    screenIndex_ = new ScreenIndex(this);
+
+    shrinkTimer_ = new QTimer(this);
+    shrinkTimer_->setSingleShot(true);
+    shrinkTimer_->setInterval(PanelSizer::SHRINK_DELAY_MS);
+    connect(shrinkTimer_, &QTimer::timeout, this, &PanelWindow::shrinkToContent);
 
     setupUi();
     connectAdaptorSignals();
     updateFromAdaptor();
+
+    prewarmer_ = new GlyphPrewarmer(theme_, devicePixelRatioF(), [this]() { return shown_; }, this);
+    prewarmer_->start();
+}
+
+bool PanelWindow::persistentSurfaceRequested() {
+    return qEnvironmentVariableIntValue("KIMPANEL_PERSISTENT_SURFACE") > 0;
+}
+
+bool PanelWindow::isPrewarming() const {
+    return prewarmer_ && prewarmer_->isRunning();
 }
 
 void PanelWindow::setupUi() {
@@ -171,51 +172,72 @@ void PanelWindow::setupUi() {
     outerLayout->setContentsMargins(0, 0, 0, 0);
     outerLayout->setSpacing(4);
 
-    auxChip_ = new DFrame(this);
+    theme_ = PanelTheme::fromWidget(this);
+
+    auxChip_ = new RoundedFrame(theme_, &PanelTheme::chipRadius, this);
     auxChip_->setObjectName("auxChip");
-    auxChip_->setFrameShape(QFrame::NoFrame);
-    auxChip_->setAutoFillBackground(true);
-    auxChip_->setAttribute(Qt::WA_StyledBackground, true);
     auxChip_->setSizePolicy(QSizePolicy::Maximum, QSizePolicy::Fixed);
 
     auto *auxLayout = new QHBoxLayout(auxChip_);
     auxLayout->setContentsMargins(6, 2, 6, 2);
     auxLayout->setSpacing(4);
 
-    auxLabel_ = new DLabel(auxChip_);
+    preeditView_ = new AttributedTextView(auxChip_);
+    preeditView_->setObjectName("preeditLabel");
+    preeditView_->setVisible(false);
+    auxLayout->addWidget(preeditView_);
+
+    auxLabel_ = new AttributedTextView(auxChip_);
     auxLabel_->setObjectName("auxLabel");
-    auxLabel_->setAlignment(Qt::AlignCenter);
-    auxLabel_->setWordWrap(false);
-    auxLabel_->setSizePolicy(QSizePolicy::Minimum, QSizePolicy::Fixed);
+    auxLabel_->setVisible(false);
     auxLayout->addWidget(auxLabel_);
 
     auxChip_->setVisible(false);
     outerLayout->addWidget(auxChip_, 0, Qt::AlignLeft);
 
-    panelFrame_ = new DFrame(this);
+    panelFrame_ = new RoundedFrame(theme_, &PanelTheme::frameRadius, this);
     panelFrame_->setObjectName("panelFrame");
-    panelFrame_->setFrameShape(QFrame::NoFrame);
-    panelFrame_->setAutoFillBackground(true);
-    panelFrame_->setAttribute(Qt::WA_StyledBackground, true);
     outerLayout->addWidget(panelFrame_, 0, Qt::AlignLeft);
 
-    auto *frameLayout = new QVBoxLayout(panelFrame_);
-    frameLayout->setContentsMargins(10, 6, 10, 8);
-    frameLayout->setSpacing(4);
+    frameLayout_ = new QVBoxLayout(panelFrame_);
+    frameLayout_->setContentsMargins(10, 6, 10, 8);
+    frameLayout_->setSpacing(4);
 
-    candidateRowHost_ = new QWidget(panelFrame_);
-    candidateRowHost_->setObjectName("candidateRow");
-    candidateRowHost_->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Minimum);
+    if (CandidateStrip::isRequested()) {
+        ensureStrip();
+        stripActive_ = true;
+    } else {
+        candidateRowHost_ = new QWidget(panelFrame_);
+        candidateRowHost_->setObjectName("candidateRow");
+        candidateRowHost_->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Minimum);
 
-    candidateRowLayout_ = new QHBoxLayout(candidateRowHost_);
-    candidateRowLayout_->setContentsMargins(0, 0, 0, 0);
-    candidateRowLayout_->setSpacing(10);
+        candidateRowLayout_ = new QHBoxLayout(candidateRowHost_);
+        candidateRowLayout_->setContentsMargins(0, 0, 0, 0);
+        candidateRowLayout_->setSpacing(10);
 
-    frameLayout->addWidget(candidateRowHost_);
+        frameLayout_->addWidget(candidateRowHost_);
+    }
 
     panelFrame_->setVisible(false);
 
-    applyStyleSheet();
+    applyTheme();
+}
+
+void PanelWindow::applyTheme() {
+    theme_ = PanelTheme::fromWidget(this);
+    // Chips inherit the row palette; Qt propagates it in one pass
+    if (candidateRowHost_) {
+        candidateRowHost_->setPalette(theme_.candidatePalette);
+    }
+    if (candidateStrip_) {
+        candidateStrip_->setTheme(theme_);
+    }
+    auxLabel_->setFont(theme_.auxFont);
+    auxLabel_->setPalette(theme_.auxPalette);
+    if (prewarmer_) {
+        prewarmer_->setTheme(theme_, devicePixelRatioF());
+    }
+    update();
 }
 
 void PanelWindow::connectAdaptorSignals() {
@@ -223,11 +245,39 @@ void PanelWindow::connectAdaptorSignals() {
         return;
     }
 
-    connect(adaptor_, &KimpanelAdaptor::lookupChanged, this, &PanelWindow::handleLookupChanged);
-    connect(adaptor_, &KimpanelAdaptor::auxChanged, this, &PanelWindow::handleAuxChanged);
-    connect(adaptor_, &KimpanelAdaptor::lookupVisibleChanged, this, &PanelWindow::handleLookupVisibleChanged);
-    connect(adaptor_, &KimpanelAdaptor::enabledChanged, this, &PanelWindow::handleEnabledChanged);
-    connect(adaptor_, &KimpanelAdaptor::spotChanged, this, &PanelWindow::handleSpotChanged);
+    scheduler_ = new PanelUpdateScheduler(adaptor_, this);
+    connect(scheduler_, &PanelUpdateScheduler::commitRequested, this, &PanelWindow::handleCommit);
+}
+
+bool PanelWindow::event(QEvent *event) {
+    const bool handled = DWidget::event(event);
+    // The top-level repaint and backing store flush happen while handling UpdateRequest
+    if (event->type() == QEvent::UpdateRequest) {
+        LatencyTracker::instance().markFlush();
+        if (scheduler_) {
+            scheduler_->framePresented();
+        }
+    }
+    return handled;
+}
+
+void PanelWindow::paintEvent(QPaintEvent *event) {
+    DWidget::paintEvent(event);
+    // The translucent top-level is painted under every dirty child rect, so its
+    // region is what this frame repaints and flushes
+    qreal area = 0;
+    for (const QRect &rect : event->region()) {
+        area += qreal(rect.width()) * rect.height();
+    }
+    const qreal dpr = devicePixelRatioF();
+    repaintStats_.lastFramePixels = static_cast<quint64>(std::llround(area * dpr * dpr));
+    repaintStats_.pixels += repaintStats_.lastFramePixels;
+    ++repaintStats_.frames;
+    LatencyTracker::instance().markPaint();
+    StartupTimeline &startup = StartupTimeline::instance();
+    if (!startup.reached(StartupTimeline::FirstCandidatePainted) && shown_ && !panelFrame_->isHidden()) {
+        startup.mark(StartupTimeline::FirstCandidatePainted);
+    }
 }
 
 void PanelWindow::changeEvent(QEvent *event) {
@@ -236,47 +286,60 @@ void PanelWindow::changeEvent(QEvent *event) {
         return;
     }
     const QEvent::Type type = event->type();
-    if (type == QEvent::PaletteChange || type == QEvent::ApplicationPaletteChange) {
-        applyStyleSheet();
-        for (QWidget *chipWidget : candidateChips_) {
-            if (auto *chip = qobject_cast<CandidateChip*>(chipWidget)) {
-                chip->update();
-            }
-        }
+    if (type == QEvent::PaletteChange || type == QEvent::ApplicationPaletteChange
+        || type == QEvent::FontChange || type == QEvent::ApplicationFontChange) {
+        applyTheme();
     }
 }
 
 void PanelWindow::updateFromAdaptor() {
-    updateCandidates();
+    if (adaptor_) {
+        updateCandidates(LookupChange::all(adaptor_->texts().size(), adaptor_->cursor()));
+    } else {
+        updateCandidates(LookupChange());
+    }
     updateAuxText();
+    updatePreedit();
     updateVisibility();
-    repositionToSpot();
 }
 
-void PanelWindow::handleLookupChanged() {
-    updateCandidates();
-    updateVisibility();
-}
+void PanelWindow::handleCommit(PanelUpdateScheduler::DirtyFlags flags,
+                               const LookupChange &lookup,
+                               int foldedSignals) {
+    Q_UNUSED(foldedSignals);
+    LatencyTracker::instance().markCommit();
 
-void PanelWindow::handleAuxChanged() {
-    updateAuxText();
-    updateVisibility();
-}
-
-void PanelWindow::handleLookupVisibleChanged() {
-    updateCandidates();
-    updateVisibility();
-}
+    // Content first, then size, then position
+    if (flags & PanelUpdateScheduler::LookupDirty) {
+        updateCandidates(lookup);
+    }
+    if (flags & PanelUpdateScheduler::AuxDirty) {
+        updateAuxText();
+    }
+    if (flags & PanelUpdateScheduler::PreeditDirty) {
+        updatePreedit();
+    }
 
-void PanelWindow::handleEnabledChanged() {
-    updateVisibility();
-}
+    const QSize sizeBefore = size();
+    const QSize contentBefore = contentSize_;
+    const bool visibleBefore = shown_;
+    if (flags & (PanelUpdateScheduler::LookupDirty
+                 | PanelUpdateScheduler::AuxDirty
+                 | PanelUpdateScheduler::PreeditDirty
+                 | PanelUpdateScheduler::VisibilityDirty)) {
+        updateVisibility();
+    }
+    LatencyTracker::instance().markLayout();
 
-void PanelWindow::handleSpotChanged() {
-    repositionToSpot();
+    // A hidden panel ignores the caret; updateVisibility() places it when it is next shown
+    const bool alreadyShown = visibleBefore && shown_;
+    if (alreadyShown && ((flags & PanelUpdateScheduler::SpotDirty) || size() != sizeBefore
+                         || contentSize_ != contentBefore)) {
+        repositionToSpot();
+    }
 }
 
-void PanelWindow::updateCandidates() {
+void PanelWindow::updateCandidates(const LookupChange &change) {
     if (!adaptor_) {
         if (panelFrame_) {
             panelFrame_->setVisible(false);
@@ -287,26 +350,75 @@ void PanelWindow::updateCandidates() {
         return;
     }
 
-    const auto labels = adaptor_->labels();
-    const auto texts = adaptor_->texts();
-    const auto comments = adaptor_->comments();
-    const int count = texts.size();
+    const auto labels = adaptor_->labelsView();
+    const auto texts = adaptor_->textsView();
+    const auto comments = adaptor_->commentsView();
+    const int count = static_cast<int>(texts.size());
+    const bool shouldShowLookup = count > 0 && adaptor_->lookupVisible();
+
+    const int cursor = adaptor_->cursor();
+    const bool vertical = adaptor_->layout() == LookupData::LayoutVertical;
+
+    // One chip per entry does not scale to symbol and emoji pickers; long
+    // tables go to the strip, which only builds its visible window
+    if (!candidateRowHost_ || count > CandidateStrip::VISIBLE_LIMIT) {
+        LookupChange stripChange = change;
+        if (!stripActive_) {
+            // The strip skipped the updates the chips handled
+            stripChange = LookupChange::all(count, cursor);
+            ensureChipCount(0);
+            candidateRowHost_->setVisible(false);
+            ensureStrip()->setVisible(true);
+            stripActive_ = true;
+        }
+        candidateStrip_->setVertical(vertical);
+        candidateStrip_->setCandidates(labels, texts, comments, stripChange, cursor);
+        panelFrame_->setVisible(shouldShowLookup);
+        return;
+    }
+
+    LookupChange chipChange = change;
+    if (stripActive_) {
+        chipChange = LookupChange::all(count, cursor);
+        candidateStrip_->setCandidates({}, {}, {}, LookupChange::all(0, -1), -1);
+        candidateStrip_->setVisible(false);
+        stripActive_ = false;
+    }
+
+    const QBoxLayout::Direction direction = vertical ? QBoxLayout::TopToBottom : QBoxLayout::LeftToRight;
+    if (candidateRowLayout_->direction() != direction) {
+        candidateRowLayout_->setDirection(direction);
+        candidateRowLayout_->setSpacing(vertical ? 2 : 10);
+    }
+
+    static const QString empty;
+    auto entry = [](std::span<const QString> list, int i) -> const QString & {
+        return i < static_cast<int>(list.size()) ? list[i] : empty;
+    };
 
     ensureChipCount(count);
 
-    for (int i = 0; i < candidateChips_.size(); ++i) {
-        auto *chip = qobject_cast<CandidateChip*>(candidateChips_.at(i));
-        if (chip && i < count) {
-            chip->setCandidate(labels.value(i), texts.value(i), comments.value(i));
-            chip->setSelected(i == adaptor_->cursor());
-            chip->show();
-        } else if (chip) {
-            chip->hide();
+    // Only touch chips whose content changed, plus the old and new cursor chips
+    if (chipChange.hasTextChanges()) {
+        const int last = std::min(chipChange.lastChanged, count - 1);
+        for (int i = std::max(chipChange.firstChanged, 0); i <= last; ++i) {
+            if (auto *chip = qobject_cast<CandidateChip*>(candidateChips_.at(i))) {
+                chip->setCandidate(entry(labels, i), texts[i], entry(comments, i));
+            }
+        }
+    }
+    if (chipChange.cursorMoved() || chipChange.countChanged) {
+        if (chipChange.previousCursor >= 0 && chipChange.previousCursor < count) {
+            if (auto *chip = qobject_cast<CandidateChip*>(candidateChips_.at(chipChange.previousCursor))) {
+                chip->setSelected(chipChange.previousCursor == cursor);
+            }
+        }
+        if (cursor >= 0 && cursor < count) {
+            if (auto *chip = qobject_cast<CandidateChip*>(candidateChips_.at(cursor))) {
+                chip->setSelected(true);
+            }
         }
     }
-
-    const bool hasCandidates = count > 0;
-    const bool shouldShowLookup = hasCandidates && adaptor_->lookupVisible();
 
     if (panelFrame_) {
         panelFrame_->setVisible(shouldShowLookup);
@@ -314,8 +426,6 @@ void PanelWindow::updateCandidates() {
     if (candidateRowHost_) {
         candidateRowHost_->setVisible(shouldShowLookup);
     }
-
-    adjustSize();
 }
 
 void PanelWindow::updateAuxText() {
@@ -325,32 +435,147 @@ void PanelWindow::updateAuxText() {
         }
         return;
     }
-    const QString auxText = adaptor_->auxText().trimmed();
+    const QString &rawText = adaptor_->auxText();
+    const QString auxText = rawText.trimmed();
     const bool shouldShow = adaptor_->auxVisible() && !auxText.isEmpty();
 
-    auxLabel_->setText(auxText);
-    if (auxChip_) {
-        auxChip_->setVisible(shouldShow);
-        if (shouldShow) {
-            auxChip_->adjustSize();
+    // Attribute offsets refer to the untrimmed text
+    int leading = 0;
+    while (leading < rawText.size() && rawText.at(leading).isSpace()) {
+        ++leading;
+    }
+    QVector<TextAttribute> attributes = adaptor_->auxAttributes();
+    if (leading > 0) {
+        for (auto &attribute : attributes) {
+            attribute.start = std::max(attribute.start - leading, 0);
         }
     }
+
+    auxLabel_->setContent(auxText, attributes);
+    auxLabel_->setVisible(shouldShow);
+    updateAuxChip();
+}
+
+void PanelWindow::updatePreedit() {
+    if (!adaptor_) {
+        return;
+    }
+    const bool shouldShow = adaptor_->preeditVisible() && !adaptor_->preeditText().isEmpty();
+    preeditView_->setContent(adaptor_->preeditText(), adaptor_->preeditAttributes(), adaptor_->preeditCaret());
+    preeditView_->setVisible(shouldShow);
+    updateAuxChip();
+}
+
+void PanelWindow::updateAuxChip() {
+    if (!auxChip_) {
+        return;
+    }
+    // The outer layout sizes the chip; resizing it here only fought the layout
+    auxChip_->setVisible(!auxLabel_->isHidden() || !preeditView_->isHidden());
 }
 
 void PanelWindow::updateVisibility() {
     if (!adaptor_) {
-        hide();
+        hidePanel();
         return;
     }
 
     const bool lookupHasContent = adaptor_->lookupVisible() && !adaptor_->texts().isEmpty();
     const bool auxHasContent = adaptor_->auxVisible() && !adaptor_->auxText().trimmed().isEmpty();
-    const bool shouldShow = adaptor_->enabled() && (lookupHasContent || auxHasContent);
-    setVisible(shouldShow);
-    if (shouldShow) {
-        raise();
-        adjustSize();
+    const bool preeditHasContent = adaptor_->preeditVisible() && !adaptor_->preeditText().isEmpty();
+    const bool shouldShow = adaptor_->enabled() && (lookupHasContent || auxHasContent || preeditHasContent);
+    if (!shouldShow) {
+        hidePanel();
+        return;
+    }
+    // Size and place before mapping so the window never appears at a stale spot
+    applySizing();
+    if (shown_) {
+        return;
+    }
+    repositionToSpot();
+    shown_ = true;
+    if (!isVisible()) {
+        show();
+    }
+    raise();
+}
+
+void PanelWindow::hidePanel() {
+    shrinkTimer_->stop();
+    shown_ = false;
+    if (!persistentSurface_ || !isVisible()) {
+        hide();
+        return;
+    }
+    // The window stays mapped with its backing store; showing it again is a move
+    if (pos() != QPoint(PARKED_X, PARKED_Y)) {
+        move(PARKED_X, PARKED_Y);
+        ++positionStats_.moves;
+    }
+}
+
+void PanelWindow::applySizing() {
+    // The content is left-aligned, so a wider window only adds transparent space
+    const QSize hint = sizeHint().expandedTo(minimumSizeHint());
+    // An exact fit would only have resized if the content changed size
+    const bool fitChanged = hint != contentSize_;
+    contentSize_ = hint;
+    const PanelSizer::Decision decision = PanelSizer::decide(hint, size(), shown_);
+    if (decision.size != size()) {
+        resize(decision.size);
+        ++sizingStats_.resizes;
+    } else if (fitChanged && hint != size()) {
+        ++sizingStats_.resizesAvoided;
+    }
+    updateInputMask();
+    // Restarted on every update, so the panel shrinks once typing pauses
+    if (decision.shrinkLater) {
+        shrinkTimer_->start();
+    } else {
+        shrinkTimer_->stop();
+    }
+}
+
+void PanelWindow::updateInputMask() {
+    // Clicks on the transparent slack belong to the window beneath. The mask is
+    // bucketed like the width so it does not change on every keystroke.
+    const int maskWidth = std::min(PanelSizer::bucketed(contentSize_.width()), width());
+    if (maskWidth >= width()) {
+        if (!mask().isEmpty()) {
+            clearMask();
+        }
+        return;
+    }
+    const QRegion region(0, 0, maskWidth, height());
+    if (mask() != region) {
+        setMask(region);
+    }
+}
+
+void PanelWindow::shrinkToContent() {
+    if (!shown_) {
+        return;
+    }
+    contentSize_ = sizeHint().expandedTo(minimumSizeHint());
+    const QSize target = PanelSizer::settled(contentSize_);
+    if (target == size()) {
+        return;
+    }
+    resize(target);
+    ++sizingStats_.resizes;
+    updateInputMask();
+    KIMPANEL_TRACE(lcTracePositioning, "shrink to %1x%2", target.width(), target.height());
+    repositionToSpot();
+}
+
+CandidateStrip *PanelWindow::ensureStrip() {
+    if (!candidateStrip_) {
+        candidateStrip_ = new CandidateStrip(panelFrame_);
+        candidateStrip_->setTheme(theme_);
+        frameLayout_->addWidget(candidateStrip_);
     }
+    return candidateStrip_;
 }
 
 void PanelWindow::ensureChipCount(int count) {
@@ -362,6 +587,7 @@ void PanelWindow::ensureChipCount(int count) {
         auto *chip = new CandidateChip(candidateRowHost_);
         candidateRowLayout_->addWidget(chip);
         candidateChips_.push_back(chip);
+        chip->show();
     }
 
     while (candidateChips_.size() > count) {
@@ -388,83 +614,24 @@ void PanelWindow::repositionToSpot() {
 
     const QPoint rawPoint(spotX, spotY);
     const QSize rawSize(std::max(spotW, 0), std::max(spotH, 0));
-    const QPointF rawPointF(rawPoint);
-
-    struct Scale {
-        qreal x = 1.0;
-        qreal y = 1.0;
-    };
-
-    auto scaleForScreen = [](QScreen *s) -> Scale {
-        if (!s) {
-            return {};
-        }
-        qreal dpr = s->devicePixelRatio();
-        if (dpr <= 0.0) {
-            dpr = s->logicalDotsPerInchX() / 96.0;
-        }
-        qreal dprY = s->devicePixelRatio();
-        if (dprY <= 0.0) {
-            dprY = s->logicalDotsPerInchY() / 96.0;
-        }
-        dpr = std::max(dpr, 0.01);
-        dprY = std::max(dprY, 0.01);
-        return {dpr, dprY};
-    };
-
-    QScreen *screen = nullptr;
-    Scale scale;
-    QPointF logicalTopLeft;
-
-    const auto screens = QGuiApplication::screens();
-    for (QScreen *candidate : screens) {
-        if (!candidate) {
-            continue;
-        }
-        const Scale candidateScale = scaleForScreen(candidate);
-        const QRect logicalGeometry = candidate->geometry();
-        const QRectF physicalRect(
-            logicalGeometry.left() * candidateScale.x,
-            logicalGeometry.top() * candidateScale.y,
-            logicalGeometry.width() * candidateScale.x,
-            logicalGeometry.height() * candidateScale.y);
-
-        if (!physicalRect.contains(rawPointF)) {
-            continue;
-        }
-
-        const QPointF offsetPhysical = rawPointF - physicalRect.topLeft();
-        const QPointF offsetLogical(offsetPhysical.x() / candidateScale.x,
-                                    offsetPhysical.y() / candidateScale.y);
 
-        screen = candidate;
-        scale = candidateScale;
-        logicalTopLeft = logicalGeometry.topLeft() + offsetLogical;
-        break;
-    }
-
-    if (!screen) {
-        screen = QGuiApplication::screenAt(rawPoint);
-        if (!screen) {
-            screen = QGuiApplication::primaryScreen();
-        }
-        if (!screen) {
-            return;
-        }
-        scale = scaleForScreen(screen);
-        logicalTopLeft = screen->geometry().topLeft()
-            + QPointF(rawPoint.x() / scale.x, rawPoint.y() / scale.y);
+    const ScreenIndex::Hit hit = screenIndex_->locate(rawPoint);
+    if (!hit.entry) {
+        return;
     }
+    const ScreenIndex::Entry &screen = *hit.entry;
+    const QPointF logicalTopLeft = hit.logicalPoint;
 
-    const QSizeF logicalSpotSize(rawSize.width() / scale.x, rawSize.height() / scale.y);
+    const QSizeF logicalSpotSize(rawSize.width() / screen.scaleX, rawSize.height() / screen.scaleY);
 
     const int caretHeight = logicalSpotSize.height() > 0.0 ? qRound(logicalSpotSize.height()) : fontMetrics().height();
     const int offsetY = 6;
 
-    QSize panelSize = isVisible() ? size() : sizeHint();
-    panelSize = panelSize.expandedTo(minimumSizeHint());
+    // Clamp what is drawn, not the window: the transparent slack right of the
+    // content may run off-screen. Callers size the window first, also before a show.
+    const QSize panelSize(contentSize_.width(), size().height());
 
-    const QRect available = screen->availableGeometry();
+    const QRect available = screen.available;
     QPoint target(qRound(logicalTopLeft.x()), qRound(logicalTopLeft.y()) + caretHeight + offsetY);
 
     const int maxX = available.x() + available.width() - panelSize.width();
@@ -482,56 +649,16 @@ void PanelWindow::repositionToSpot() {
         target.setY(std::clamp(target.y(), available.y(), maxY));
     }
 
-    move(target);
-    qDebug() << "[POSITIONING] Screen" << screen->name()
-             << "raw" << rawPoint << "scale" << scale.x << scale.y
-             << "logicalTopLeft" << logicalTopLeft << "caretHeight" << caretHeight
-             << "target" << target << "panelSize" << panelSize;
-}
-
-void PanelWindow::applyStyleSheet() {
-    static const QString sheet = QStringLiteral(R"(
-#panelFrame {
-    border-radius: 10px;
-    border: 1px solid palette(midlight);
-    background: palette(window);
-}
-
-#auxChip {
-    border-radius: 6px;
-    border: 1px solid palette(midlight);
-    background: palette(window);
-}
-
-#auxLabel {
-    color: palette(text);
-    font-weight: 500;
-}
-
-CandidateChip {
-    background: transparent;
-}
-
-CandidateChip[selected="true"] {
-    background: transparent;
-}
-
-#candidateComment {
-    color: palette(mid);
-}
-)");
-
-    const QString current = styleSheet();
-    if (current == sheet) {
-        DWidget::setStyleSheet(QString());
-    }
-    DWidget::setStyleSheet(sheet);
-    if (panelFrame_) {
-        panelFrame_->update();
-    }
-    if (auxChip_) {
-        auxChip_->update();
+    if (target == pos()) {
+        ++positionStats_.movesSkipped;
+        return;
     }
+    move(target);
+    ++positionStats_.moves;
+    KIMPANEL_TRACE(lcTracePositioning,
+                   "reposition raw=(%1,%2) scale=%3% caretHeight=%4 target=(%5,%6) panel=%7x%8",
+                   rawPoint.x(), rawPoint.y(), qRound(screen.scaleX * 100), caretHeight,
+                   target.x(), target.y(), panelSize.width(), panelSize.height());
 }
 
 #include "PanelWindow.moc"
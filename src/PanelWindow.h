@@ -1,55 +1,120 @@
 #pragma once
 
+#include "PanelSizer.h"
+#include "PanelTheme.h"
+#include "PanelUpdateScheduler.h"
+
 #include <DWidget>
 
 #include <QVector>
 
+class AttributedTextView;
+class CandidateStrip;
+class GlyphPrewarmer;
 class KimpanelAdaptor;
-
-namespace Dtk {
-namespace Widget {
-class DLabel;
-class DFrame;
-}
-}
+class ScreenIndex;
 
 class QHBoxLayout;
+class QTimer;
 class QVBoxLayout;
 class QWidget;
 class QEvent;
+class QPaintEvent;
 
 class PanelWindow : public Dtk::Widget::DWidget {
     Q_OBJECT
 public:
     explicit PanelWindow(KimpanelAdaptor *adaptor, QWidget *parent = nullptr);
 
+    // KIMPANEL_PERSISTENT_SURFACE=1: once mapped, the window is never unmapped;
+    // hiding parks it off-screen so the next show skips the map round trip
+    static bool persistentSurfaceRequested();
+
+    struct SizingStats {
+        // Top-level size changes actually applied
+        quint64 resizes = 0;
+        // Updates where an exact fit would have resized the window but PanelSizer kept it
+        quint64 resizesAvoided = 0;
+    };
+
+    struct PositionStats {
+        // move() calls, i.e. window position changes sent to the window system
+        quint64 moves = 0;
+        // Repositions that landed on the current position
+        quint64 movesSkipped = 0;
+    };
+
+    struct RepaintStats {
+        quint64 frames = 0;
+        // Device pixels repainted, from the paint event regions
+        quint64 pixels = 0;
+        quint64 lastFramePixels = 0;
+    };
+
+    PanelUpdateScheduler *scheduler() const { return scheduler_; }
+    const SizingStats &sizingStats() const { return sizingStats_; }
+    const PositionStats &positionStats() const { return positionStats_; }
+    // Whether the panel is showing content; with a persistent surface the
+    // window stays visible to Qt while parked
+    bool isShown() const { return shown_; }
+    const RepaintStats &repaintStats() const { return repaintStats_; }
+    // Glyph cache warming still has idle-time steps to run, see GlyphPrewarmer
+    bool isPrewarming() const;
+
 private slots:
-    void handleLookupChanged();
-    void handleAuxChanged();
-    void handleLookupVisibleChanged();
-    void handleEnabledChanged();
-    void handleSpotChanged();
+    void handleCommit(PanelUpdateScheduler::DirtyFlags flags,
+                      const LookupChange &lookup,
+                      int foldedSignals);
 
 private:
     void setupUi();
     void connectAdaptorSignals();
     void updateFromAdaptor();
-    void updateCandidates();
+    void updateCandidates(const LookupChange &change);
     void updateAuxText();
+    void updatePreedit();
+    void updateAuxChip();
     void updateVisibility();
+    void hidePanel();
+    void applySizing();
+    void updateInputMask();
+    void shrinkToContent();
     void ensureChipCount(int count);
+    CandidateStrip *ensureStrip();
     void repositionToSpot();
-    void applyStyleSheet();
+    void applyTheme();
 
+    bool event(QEvent *event) override;
     void changeEvent(QEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
 
     KimpanelAdaptor *adaptor_ = nullptr;
+    PanelUpdateScheduler *scheduler_ = nullptr;
 
-    Dtk::Widget::DFrame *panelFrame_ = nullptr;
-    Dtk::Widget::DFrame *auxChip_ = nullptr;
-    Dtk::Widget::DLabel *auxLabel_ = nullptr;
+    QWidget *panelFrame_ = nullptr;
+    QWidget *auxChip_ = nullptr;
+    AttributedTextView *preeditView_ = nullptr;
+    AttributedTextView *auxLabel_ = nullptr;
     QWidget *candidateRowHost_ = nullptr;
     QHBoxLayout *candidateRowLayout_ = nullptr;
+    QVBoxLayout *frameLayout_ = nullptr;
+    // Replaces candidateRowHost_ and the chips when KIMPANEL_CANDIDATE_RENDERER=strip;
+    // otherwise built on the first table too long for chips
+    CandidateStrip *candidateStrip_ = nullptr;
+    // The strip, not the chips, shows the current table
+    bool stripActive_ = false;
 
     QVector<QWidget*> candidateChips_;
+    PanelTheme theme_;
+
+    ScreenIndex *screenIndex_ = nullptr;
+    GlyphPrewarmer *prewarmer_ = nullptr;
+    QTimer *shrinkTimer_ = nullptr;
+    // Exact size of the left-aligned content; the window may be wider
+    QSize contentSize_;
+    SizingStats sizingStats_;
+    PositionStats positionStats_;
+    bool persistentSurface_ = false;
+    bool shown_ = false;
+    RepaintStats repaintStats_;
 };
@@ -0,0 +1,71 @@
+#include "PropertyParser.h"
+
+namespace PropertyParser {
+
+PanelProperty parseProperty(QStringView raw) {
+    PanelProperty prop;
+    if (raw.isEmpty()) {
+        return prop;
+    }
+
+    // key:label:icon:tip[:hint], where the hint may itself contain ':'
+    qsizetype separators[4] = {};
+    qsizetype found = 0;
+    for (qsizetype from = 0; found < 4; ++found) {
+        const qsizetype idx = raw.indexOf(QLatin1Char(':'), from);
+        if (idx < 0) {
+            break;
+        }
+        separators[found] = idx;
+        from = idx + 1;
+    }
+    if (found < 3) {
+        return prop;
+    }
+
+    const qsizetype tipEnd = found > 3 ? separators[3] : raw.size();
+    prop.key = raw.first(separators[0]).toString();
+    prop.label = raw.sliced(separators[0] + 1, separators[1] - separators[0] - 1).toString();
+    prop.icon = raw.sliced(separators[1] + 1, separators[2] - separators[1] - 1).toString();
+    prop.tip = raw.sliced(separators[2] + 1, tipEnd - separators[2] - 1).toString();
+    if (found > 3) {
+        const QStringView hint = raw.sliced(separators[3] + 1);
+        prop.hint = hint.toString();
+        prop.hints = parseHints(hint);
+    }
+    return prop;
+}
+
+QVector<PanelProperty> parsePropertyList(const QStringList &list) {
+    QVector<PanelProperty> parsed;
+    parsed.reserve(list.size());
+    for (const QString &raw : list) {
+        auto prop = parseProperty(raw);
+        if (prop.isValid()) {
+            parsed.push_back(std::move(prop));
+        }
+    }
+    return parsed;
+}
+
+PropertyHints parseHints(QStringView hint) {
+    PropertyHints hints;
+    qsizetype from = 0;
+    while (from <= hint.size()) {
+        qsizetype end = hint.indexOf(QLatin1Char(','), from);
+        if (end < 0) {
+            end = hint.size();
+        }
+        const QStringView part = hint.sliced(from, end - from).trimmed();
+        from = end + 1;
+
+        const qsizetype eq = part.indexOf(QLatin1Char('='));
+        if (eq <= 0) {
+            continue;
+        }
+        hints.entries.push_back({part.first(eq).toString(), part.sliced(eq + 1).toString()});
+    }
+    return hints;
+}
+
+}
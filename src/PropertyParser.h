@@ -0,0 +1,16 @@
+#pragma once
+
+#include "PropertyStore.h"
+
+#include <QStringList>
+#include <QStringView>
+#include <QVector>
+
+// Tokenizes the kimpanel property wire format in place. Fields are only
+// materialized once as the strings stored on the property; no intermediate
+// lists are built.
+namespace PropertyParser {
+PanelProperty parseProperty(QStringView raw);
+QVector<PanelProperty> parsePropertyList(const QStringList &list);
+PropertyHints parseHints(QStringView hint);
+}
@@ -0,0 +1,95 @@
+#include "PropertyStore.h"
+
+const PanelProperty *PropertyStore::find(const QString &key) const {
+    const auto it = index_.constFind(key);
+    if (it == index_.constEnd()) {
+        return nullptr;
+    }
+    return &items_.at(it.value());
+}
+
+PropertyChangeSet PropertyStore::replaceAll(QVector<PanelProperty> props) {
+    PropertyChangeSet changes;
+
+    QVector<PanelProperty> next;
+    next.reserve(props.size());
+    QHash<QString, qsizetype> nextIndex;
+    nextIndex.reserve(props.size());
+
+    for (auto &prop : props) {
+        if (!prop.isValid() || nextIndex.contains(prop.key)) {
+            continue;
+        }
+        const auto old = index_.constFind(prop.key);
+        if (old == index_.constEnd()) {
+            changes.changedKeys << prop.key;
+            changes.structureChanged = true;
+        } else {
+            prop.key = old.key();
+            if (old.value() != next.size()) {
+                changes.structureChanged = true;
+            }
+            if (items_.at(old.value()) != prop) {
+                changes.changedKeys << prop.key;
+            }
+        }
+        nextIndex.insert(prop.key, next.size());
+        next.push_back(std::move(prop));
+    }
+
+    for (const auto &prop : std::as_const(items_)) {
+        if (!nextIndex.contains(prop.key)) {
+            changes.changedKeys << prop.key;
+            changes.structureChanged = true;
+        }
+    }
+
+    items_ = std::move(next);
+    index_ = std::move(nextIndex);
+    return changes;
+}
+
+PropertyChangeSet PropertyStore::upsert(PanelProperty prop) {
+    PropertyChangeSet changes;
+    if (!prop.isValid()) {
+        return changes;
+    }
+    const auto it = index_.constFind(prop.key);
+    if (it != index_.constEnd()) {
+        PanelProperty &current = items_[it.value()];
+        if (current == prop) {
+            return changes;
+        }
+        prop.key = it.key();
+        current = std::move(prop);
+        changes.changedKeys << current.key;
+        return changes;
+    }
+
+    index_.insert(prop.key, items_.size());
+    changes.changedKeys << prop.key;
+    changes.structureChanged = true;
+    items_.push_back(std::move(prop));
+    return changes;
+}
+
+PropertyChangeSet PropertyStore::remove(const QString &key) {
+    PropertyChangeSet changes;
+    const auto it = index_.constFind(key);
+    if (it == index_.constEnd()) {
+        return changes;
+    }
+    const qsizetype idx = it.value();
+    changes.changedKeys << it.key();
+    changes.structureChanged = true;
+    index_.erase(it);
+    items_.removeAt(idx);
+    rebuildIndex(idx);
+    return changes;
+}
+
+void PropertyStore::rebuildIndex(qsizetype from) {
+    for (qsizetype i = from; i < items_.size(); ++i) {
+        index_[items_.at(i).key] = i;
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Pre-parsed "key=value,key=value" hint table of a property
+struct PropertyHints {
+    struct Entry {
+        QString key;
+        QString value;
+
+        bool operator==(const Entry &other) const = default;
+    };
+
+    QVector<Entry> entries;
+
+    QString value(QStringView key) const {
+        for (const auto &entry : entries) {
+            if (entry.key == key) {
+                return entry.value;
+            }
+        }
+        return {};
+    }
+    bool operator==(const PropertyHints &other) const = default;
+};
+
+// One org.kde.kimpanel.inputmethod property ("key:label:icon:tip[:hint]")
+struct PanelProperty {
+    QString key;
+    QString label;
+    QString icon;
+    QString tip;
+    QString hint;
+    PropertyHints hints;
+
+    bool operator==(const PanelProperty &other) const = default;
+    bool isValid() const { return !key.isEmpty(); }
+};
+
+// Keys touched by one store operation; only keys whose fields differ are listed
+struct PropertyChangeSet {
+    QStringList changedKeys;
+    // Set when keys were added, removed or reordered
+    bool structureChanged = false;
+
+    bool isEmpty() const { return changedKeys.isEmpty() && !structureChanged; }
+    bool contains(const QString &key) const { return changedKeys.contains(key); }
+};
+
+// Ordered property list with an O(1) key index. Keys are interned: the stored
+// property, the index and later registrations of the same key share one
+// string buffer.
+class PropertyStore {
+public:
+    const QVector<PanelProperty> &items() const { return items_; }
+    const PanelProperty *find(const QString &key) const;
+
+    PropertyChangeSet replaceAll(QVector<PanelProperty> props);
+    PropertyChangeSet upsert(PanelProperty prop);
+    PropertyChangeSet remove(const QString &key);
+
+private:
+    void rebuildIndex(qsizetype from);
+
+    QVector<PanelProperty> items_;
+    QHash<QString, qsizetype> index_;
+};
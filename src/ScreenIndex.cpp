@@ -0,0 +1,110 @@
+#include "ScreenIndex.h"
+
+#include "Trace.h"
+
+#include <QGuiApplication>
+#include <QScreen>
+
+#include <algorithm>
+
+namespace {
+qreal scaleOf(qreal dpr, qreal logicalDpi) {
+    if (dpr <= 0.0) {
+        dpr = logicalDpi / 96.0;
+    }
+    return std::max(dpr, 0.01);
+}
+}
+
+ScreenIndex::ScreenIndex(QObject *parent)
+    : QObject(parent) {
+    connect(qGuiApp, &QGuiApplication::screenAdded, this, [this](QScreen *screen) {
+        watch(screen);
+        invalidate();
+    });
+    connect(qGuiApp, &QGuiApplication::screenRemoved, this, &ScreenIndex::invalidate);
+    connect(qGuiApp, &QGuiApplication::primaryScreenChanged, this, &ScreenIndex::invalidate);
+    const auto screens = QGuiApplication::screens();
+    for (QScreen *screen : screens) {
+        watch(screen);
+    }
+}
+
+void ScreenIndex::watch(QScreen *screen) {
+    // A scale change shows up as a geometry or logical DPI change
+    connect(screen, &QScreen::geometryChanged, this, &ScreenIndex::invalidate);
+    connect(screen, &QScreen::availableGeometryChanged, this, &ScreenIndex::invalidate);
+    connect(screen, &QScreen::logicalDotsPerInchChanged, this, &ScreenIndex::invalidate);
+}
+
+void ScreenIndex::invalidate() {
+    dirty_ = true;
+}
+
+void ScreenIndex::rebuild() {
+    entries_.clear();
+    primary_ = -1;
+    lastHit_ = -1;
+    const QScreen *primary = QGuiApplication::primaryScreen();
+    const auto screens = QGuiApplication::screens();
+    for (QScreen *screen : screens) {
+        if (!screen) {
+            continue;
+        }
+        Entry entry;
+        entry.screen = screen;
+        entry.geometry = screen->geometry();
+        entry.available = screen->availableGeometry();
+        entry.scaleX = scaleOf(screen->devicePixelRatio(), screen->logicalDotsPerInchX());
+        entry.scaleY = scaleOf(screen->devicePixelRatio(), screen->logicalDotsPerInchY());
+        entry.physical = QRectF(entry.geometry.left() * entry.scaleX,
+                                entry.geometry.top() * entry.scaleY,
+                                entry.geometry.width() * entry.scaleX,
+                                entry.geometry.height() * entry.scaleY);
+        if (screen == primary) {
+            primary_ = entries_.size();
+        }
+        entries_.push_back(entry);
+    }
+    dirty_ = false;
+    ++rebuilds_;
+    KIMPANEL_TRACE(lcTracePositioning, "screen index rebuilt screens=%1", entries_.size());
+}
+
+ScreenIndex::Hit ScreenIndex::locate(const QPoint &raw) {
+    if (dirty_) {
+        rebuild();
+    }
+    const QPointF rawF(raw);
+    auto physicalHit = [&](qsizetype i) -> Hit {
+        const Entry &entry = entries_.at(i);
+        lastHit_ = i;
+        const QPointF offset = rawF - entry.physical.topLeft();
+        return {&entry, entry.geometry.topLeft() + QPointF(offset.x() / entry.scaleX, offset.y() / entry.scaleY)};
+    };
+
+    if (lastHit_ >= 0 && entries_.at(lastHit_).physical.contains(rawF)) {
+        return physicalHit(lastHit_);
+    }
+    for (qsizetype i = 0; i < entries_.size(); ++i) {
+        if (i != lastHit_ && entries_.at(i).physical.contains(rawF)) {
+            return physicalHit(i);
+        }
+    }
+
+    // Not on any device rect: treat the point as logical, as screenAt() would
+    const Entry *fallback = nullptr;
+    for (const Entry &entry : std::as_const(entries_)) {
+        if (entry.geometry.contains(raw)) {
+            fallback = &entry;
+            break;
+        }
+    }
+    if (!fallback && primary_ >= 0) {
+        fallback = &entries_.at(primary_);
+    }
+    if (!fallback) {
+        return {};
+    }
+    return {fallback, fallback->geometry.topLeft() + QPointF(raw.x() / fallback->scaleX, raw.y() / fallback->scaleY)};
+}
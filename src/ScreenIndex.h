@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QObject>
+#include <QPointF>
+#include <QRect>
+#include <QRectF>
+#include <QVector>
+
+class QScreen;
+
+// Screen topology precomputed for caret positioning. Input methods report the
+// caret in physical pixels; mapping it back needs each screen's scale and
+// device rect, which only change when screens come, go or are reconfigured.
+// The index is rebuilt lazily after such a signal instead of on every caret move.
+class ScreenIndex : public QObject {
+    Q_OBJECT
+public:
+    struct Entry {
+        QScreen *screen = nullptr;
+        QRect geometry;
+        QRect available;
+        // geometry scaled to device pixels
+        QRectF physical;
+        qreal scaleX = 1.0;
+        qreal scaleY = 1.0;
+    };
+
+    struct Hit {
+        const Entry *entry = nullptr;
+        // Caret point in logical desktop coordinates
+        QPointF logicalPoint;
+    };
+
+    explicit ScreenIndex(QObject *parent = nullptr);
+
+    // The screen whose device rect holds the raw point, else the one whose
+    // logical rect does, else the primary screen; entry is null without screens
+    Hit locate(const QPoint &raw);
+
+    quint64 rebuilds() const { return rebuilds_; }
+
+private:
+    void watch(QScreen *screen);
+    void invalidate();
+    void rebuild();
+
+    QVector<Entry> entries_;
+    qsizetype primary_ = -1;
+    // Consecutive caret points are nearly always on the same screen
+    qsizetype lastHit_ = -1;
+    bool dirty_ = true;
+    quint64 rebuilds_ = 0;
+};
@@ -0,0 +1,47 @@
+#include "StartupTimeline.h"
+
+#include "LatencyTracker.h"
+
+#include <QDebug>
+
+StartupTimeline &StartupTimeline::instance() {
+    static StartupTimeline timeline;
+    return timeline;
+}
+
+void StartupTimeline::begin() {
+    originNs_ = LatencyTracker::now();
+}
+
+void StartupTimeline::mark(Milestone milestone) {
+    if (at_[milestone] != 0) {
+        return;
+    }
+    at_[milestone] = LatencyTracker::now();
+    qInfo().noquote() << "[Startup]" << milestoneName(milestone)
+                      << QStringLiteral("%1ms").arg((at_[milestone] - originNs_) / 1e6, 0, 'f', 1);
+}
+
+QStringList StartupTimeline::report() const {
+    QStringList lines;
+    for (int i = 0; i < MilestoneCount; ++i) {
+        if (at_[i] != 0) {
+            lines << QStringLiteral("%1=%2ms")
+                         .arg(QString::fromLatin1(milestoneName(static_cast<Milestone>(i))))
+                         .arg((at_[i] - originNs_) / 1e6, 0, 'f', 1);
+        }
+    }
+    return lines;
+}
+
+const char *StartupTimeline::milestoneName(Milestone milestone) {
+    switch (milestone) {
+    case BusReady: return "bus-ready";
+    case PanelCreated: return "panel-created";
+    case TrayCreated: return "tray-created";
+    case FirstCandidatePainted: return "first-candidate-painted";
+    case GlyphsWarmed: return "glyphs-warmed";
+    case MilestoneCount: break;
+    }
+    return "unknown";
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QStringList>
+
+#include <array>
+
+// Startup milestones, measured from main() on the LatencyTracker clock. Each
+// milestone keeps its first time and is logged with a [Startup] prefix once.
+class StartupTimeline {
+public:
+    enum Milestone {
+        // org.kde.impanel claimed and the adaptor exported
+        BusReady,
+        PanelCreated,
+        TrayCreated,
+        // First paint of the panel with candidates on it
+        FirstCandidatePainted,
+        // GlyphPrewarmer went through its character list
+        GlyphsWarmed,
+        MilestoneCount,
+    };
+
+    static StartupTimeline &instance();
+
+    // First thing in main()
+    void begin();
+    // GUI thread only
+    void mark(Milestone milestone);
+    bool reached(Milestone milestone) const { return at_[milestone] != 0; }
+    // "milestone=<ms>" per milestone reached so far
+    QStringList report() const;
+
+    static const char *milestoneName(Milestone milestone);
+
+private:
+    StartupTimeline() = default;
+
+    qint64 originNs_ = 0;
+    std::array<qint64, MilestoneCount> at_ = {};
+};
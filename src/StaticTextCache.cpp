@@ -0,0 +1,48 @@
+#include "StaticTextCache.h"
+
+#include <QTransform>
+
+namespace {
+// A few pages of candidates across a session's common characters and phrases
+constexpr qsizetype CAPACITY = 2048;
+}
+
+StaticTextCache &StaticTextCache::instance() {
+    static StaticTextCache cache;
+    return cache;
+}
+
+StaticTextCache::StaticTextCache()
+    : cache_(CAPACITY) {}
+
+QStaticText StaticTextCache::text(const QString &string, const QFont &font, qreal devicePixelRatio) {
+    Key key{string, font.key(), devicePixelRatio};
+    if (const QStaticText *cached = cache_.object(key)) {
+        ++hits_;
+        return *cached;
+    }
+    ++misses_;
+    auto *shaped = new QStaticText(string);
+    shaped->setTextFormat(Qt::PlainText);
+    shaped->setPerformanceHint(QStaticText::AggressiveCaching);
+    // Shape for the scale the backing store paints with, or the first draw
+    // would lay the shared entry out again
+    shaped->prepare(QTransform::fromScale(devicePixelRatio, devicePixelRatio), font);
+    const QStaticText result = *shaped;
+    cache_.insert(std::move(key), shaped);
+    return result;
+}
+
+void StaticTextCache::clear() {
+    cache_.clear();
+    ++clears_;
+}
+
+StaticTextCache::Stats StaticTextCache::stats() const {
+    Stats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.clears = clears_;
+    stats.size = cache_.size();
+    return stats;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QCache>
+#include <QFont>
+#include <QStaticText>
+#include <QString>
+
+// Bounded LRU of pre-shaped candidate strings. Entries are keyed by string,
+// font and device pixel ratio; colours are not part of the key because a
+// QStaticText takes the pen at draw time, so selected and unselected
+// candidates share one entry.
+class StaticTextCache {
+public:
+    struct Stats {
+        quint64 hits = 0;
+        quint64 misses = 0;
+        quint64 clears = 0;
+        qsizetype size = 0;
+    };
+
+    static StaticTextCache &instance();
+
+    // The returned handle is implicitly shared and stays valid after eviction
+    QStaticText text(const QString &string, const QFont &font, qreal devicePixelRatio);
+
+    // Drops everything, e.g. on font, theme or screen scale changes
+    void clear();
+    Stats stats() const;
+
+private:
+    struct Key {
+        QString string;
+        QString font;
+        qreal devicePixelRatio = 1.0;
+
+        bool operator==(const Key &other) const = default;
+    };
+    friend size_t qHash(const Key &key, size_t seed) {
+        return qHashMulti(seed, key.string, key.font, key.devicePixelRatio);
+    }
+
+    StaticTextCache();
+
+    QCache<Key, QStaticText> cache_;
+    quint64 hits_ = 0;
+    quint64 misses_ = 0;
+    quint64 clears_ = 0;
+};
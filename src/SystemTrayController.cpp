@@ -17,6 +17,10 @@ SystemTrayController::SystemTrayController(KimpanelAdaptor *adaptor, QObject *pa
         return;
     }
 
+    // Cycling needs no tray; keep it working for cycleInputMethod() on headless sessions
+    connect(adaptor_, &KimpanelAdaptor::execMenuReceived,
+            this, &SystemTrayController::onExecMenuRequested);
+
     disabledByEnv_ = qEnvironmentVariableIsSet("KIMPANEL_DISABLE_SNI");
     if (disabledByEnv_) {
         qInfo() << "[Tray] Disabled by env KIMPANEL_DISABLE_SNI";
@@ -30,14 +34,10 @@ SystemTrayController::SystemTrayController(KimpanelAdaptor *adaptor, QObject *pa
 
     setupTray();
 
-    connect(adaptor_, &KimpanelAdaptor::propertiesChanged,
-            this, &SystemTrayController::updateTrayFromProperties);
-    connect(adaptor_, &KimpanelAdaptor::propertyChanged,
-            this, &SystemTrayController::onPropertyChanged);
+    connect(adaptor_, &KimpanelAdaptor::propertiesUpdated,
+            this, &SystemTrayController::onPropertiesUpdated);
     connect(adaptor_, &KimpanelAdaptor::enabledChanged,
             this, &SystemTrayController::onEnabledChanged);
-    connect(adaptor_, &KimpanelAdaptor::execMenuReceived,
-            this, &SystemTrayController::onExecMenuRequested);
 
     refreshIconAndTooltip();
 }
@@ -64,12 +64,8 @@ void SystemTrayController::setupTray() {
     tray_->show();
 }
 
-void SystemTrayController::updateTrayFromProperties() {
-    refreshIconAndTooltip();
-}
-
-void SystemTrayController::onPropertyChanged(const QString &key) {
-    if (key == trackedKey_) {
+void SystemTrayController::onPropertiesUpdated(const PropertyChangeSet &changes) {
+    if (changes.contains(trackedKey_)) {
         refreshIconAndTooltip();
     }
 }
@@ -86,9 +82,8 @@ void SystemTrayController::refreshIconAndTooltip() {
     QIcon icon;
     QString tooltip;
 
-    const auto propOpt = adaptor_->propertyForKey(trackedKey_);
-    if (propOpt.has_value()) {
-        const auto &prop = propOpt.value();
+    if (const auto *tracked = adaptor_->findProperty(trackedKey_)) {
+        const auto &prop = *tracked;
         if (!prop.icon.isEmpty()) {
             icon = QIcon::fromTheme(prop.icon);
             if (icon.isNull()) {
@@ -97,7 +92,7 @@ void SystemTrayController::refreshIconAndTooltip() {
         }
 
         QStringList tooltipLines;
-        const QString hintLabel = extractHintValue(prop.hint, QStringLiteral("label"));
+        const QString hintLabel = prop.hints.value(u"label");
         if (!hintLabel.isEmpty()) {
             tooltipLines << hintLabel;
         }
@@ -129,21 +124,6 @@ void SystemTrayController::refreshIconAndTooltip() {
     tray_->show();
 }
 
-QString SystemTrayController::extractHintValue(const QString &hint, const QString &key) const {
-    if (hint.isEmpty() || key.isEmpty()) {
-        return {};
-    }
-    const QString search = key + QLatin1Char('=');
-    const QStringList parts = hint.split(QLatin1Char(','), Qt::SkipEmptyParts);
-    for (const QString &part : parts) {
-        const QString trimmed = part.trimmed();
-        if (trimmed.startsWith(search)) {
-            return trimmed.mid(search.size());
-        }
-    }
-    return {};
-}
-
 void SystemTrayController::triggerPrimaryProperty() {
     if (!adaptor_) {
         return;
@@ -155,12 +135,6 @@ void SystemTrayController::triggerPrimaryProperty() {
 }
 
 void SystemTrayController::onExecMenuRequested(const QVector<KimpanelAdaptor::Property> &entries) {
-    if (!tray_) {
-        pendingMenuPosValid_ = false;
-        autoCyclePending_ = false;
-        return;
-    }
-
     if (autoCyclePending_) {
         autoCyclePending_ = false;
         if (entries.isEmpty()) {
@@ -219,6 +193,11 @@ void SystemTrayController::onExecMenuRequested(const QVector<KimpanelAdaptor::Pr
         return;
     }
 
+    if (!tray_) {
+        pendingMenuPosValid_ = false;
+        return;
+    }
+
     if (!switchMenu_) {
         switchMenu_ = std::make_unique<QMenu>();
         switchMenu_->setSeparatorsCollapsible(false);
@@ -253,7 +232,7 @@ void SystemTrayController::onExecMenuRequested(const QVector<KimpanelAdaptor::Pr
                 action->setIcon(icon);
             }
         }
-        const QString hintLabel = extractHintValue(entry.hint, QStringLiteral("label"));
+        const QString hintLabel = entry.hints.value(u"label");
         if (!hintLabel.isEmpty() && hintLabel != text) {
             action->setStatusTip(hintLabel);
         }
@@ -281,7 +260,14 @@ void SystemTrayController::onTrayActivated(QSystemTrayIcon::ActivationReason rea
     }
     if (reason == QSystemTrayIcon::Trigger || reason == QSystemTrayIcon::DoubleClick ||
         reason == QSystemTrayIcon::MiddleClick) {
-        autoCyclePending_ = true;
-        adaptor_->triggerProperty(trackedKey_);
+        cycleInputMethod();
     }
 }
+
+void SystemTrayController::cycleInputMethod() {
+    if (!adaptor_) {
+        return;
+    }
+    autoCyclePending_ = true;
+    adaptor_->triggerProperty(trackedKey_);
+}
@@ -16,9 +16,13 @@ class SystemTrayController : public QObject {
 public:
     explicit SystemTrayController(KimpanelAdaptor *adaptor, QObject *parent = nullptr);
 
+public slots:
+    // What a left click on the tray icon does: ask the engine for the input
+    // method menu and switch to the entry after the active one
+    void cycleInputMethod();
+
 private slots:
-    void updateTrayFromProperties();
-    void onPropertyChanged(const QString &key);
+    void onPropertiesUpdated(const PropertyChangeSet &changes);
     void onEnabledChanged();
     void onTrayActivated(QSystemTrayIcon::ActivationReason reason);
     void onExecMenuRequested(const QVector<KimpanelAdaptor::Property> &entries);
@@ -27,7 +31,6 @@ private slots:
 private:
     void setupTray();
     void refreshIconAndTooltip();
-    QString extractHintValue(const QString &hint, const QString &key) const;
     void triggerPrimaryProperty();
 
     KimpanelAdaptor *adaptor_ = nullptr;
@@ -0,0 +1,51 @@
+#include "TextAttribute.h"
+
+QVector<TextAttribute> parseTextAttributes(QStringView attr) {
+    QVector<TextAttribute> attributes;
+    qsizetype from = 0;
+    while (from < attr.size()) {
+        qsizetype end = attr.indexOf(QLatin1Char(';'), from);
+        if (end < 0) {
+            end = attr.size();
+        }
+        const QStringView entry = attr.sliced(from, end - from);
+        from = end + 1;
+
+        int fields[4] = {};
+        int count = 0;
+        qsizetype fieldFrom = 0;
+        bool ok = true;
+        while (ok && count < 4 && fieldFrom <= entry.size()) {
+            qsizetype fieldEnd = entry.indexOf(QLatin1Char(':'), fieldFrom);
+            if (fieldEnd < 0) {
+                fieldEnd = entry.size();
+            }
+            fields[count++] = entry.sliced(fieldFrom, fieldEnd - fieldFrom).toInt(&ok);
+            fieldFrom = fieldEnd + 1;
+        }
+        if (!ok || count < 4 || fields[0] <= TextAttribute::None || fields[0] > TextAttribute::Background
+            || fields[1] < 0 || fields[2] <= 0) {
+            continue;
+        }
+        TextAttribute attribute;
+        attribute.type = static_cast<TextAttribute::Type>(fields[0]);
+        attribute.start = fields[1];
+        attribute.length = fields[2];
+        attribute.value = fields[3];
+        attributes.push_back(attribute);
+    }
+    return attributes;
+}
+
+qsizetype utf16Offset(QStringView text, int codePoints) {
+    qsizetype index = 0;
+    for (int i = 0; i < codePoints && index < text.size(); ++i) {
+        if (text.at(index).isHighSurrogate() && index + 1 < text.size()
+            && text.at(index + 1).isLowSurrogate()) {
+            index += 2;
+        } else {
+            index += 1;
+        }
+    }
+    return index;
+}
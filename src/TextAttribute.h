@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QString>
+#include <QStringView>
+#include <QVector>
+
+// One entry of a kimpanel attribute string ("type:start:length:value;...").
+// start and length count Unicode code points, like the preedit caret.
+struct TextAttribute {
+    enum Type {
+        None = 0,
+        Decorate = 1,
+        Foreground = 2,
+        Background = 3,
+    };
+    enum Decoration {
+        NoDecoration = 0,
+        Underline = 1,
+        Highlight = 2,
+        Reverse = 3,
+    };
+
+    Type type = None;
+    int start = 0;
+    int length = 0;
+    // Decoration for Decorate, 0xRRGGBB for Foreground/Background
+    int value = 0;
+
+    bool operator==(const TextAttribute &other) const = default;
+};
+
+QVector<TextAttribute> parseTextAttributes(QStringView attr);
+
+// Converts a code point offset into a UTF-16 index into text, clamped to its size
+qsizetype utf16Offset(QStringView text, int codePoints);
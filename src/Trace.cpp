@@ -0,0 +1,82 @@
+#include "Trace.h"
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+
+Q_LOGGING_CATEGORY(lcTracePositioning, "kimpanel.positioning")
+Q_LOGGING_CATEGORY(lcTraceLookup, "kimpanel.lookup")
+Q_LOGGING_CATEGORY(lcTraceCommit, "kimpanel.commit")
+
+namespace {
+QElapsedTimer &traceClock() {
+    static QElapsedTimer clock = []() {
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+    return clock;
+}
+}
+
+TraceRing &TraceRing::instance() {
+    static TraceRing ring;
+    return ring;
+}
+
+void TraceRing::append(const char *category, const char *event,
+                       const std::array<qint64, MAX_ARGS> &values, int count) {
+    const quint64 ticket = next_.fetch_add(1, std::memory_order_relaxed);
+    Entry &entry = entries_[ticket % CAPACITY];
+    entry.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    entry.timestampNs.store(traceClock().nsecsElapsed(), std::memory_order_relaxed);
+    entry.category.store(category, std::memory_order_relaxed);
+    entry.event.store(event, std::memory_order_relaxed);
+    for (int v = 0; v < count; ++v) {
+        entry.values[v].store(values[v], std::memory_order_relaxed);
+    }
+    entry.valueCount.store(count, std::memory_order_relaxed);
+    entry.sequence.store(ticket + 1, std::memory_order_release);
+}
+
+QStringList TraceRing::dump() const {
+    QStringList lines;
+    const quint64 end = next_.load(std::memory_order_relaxed);
+    const quint64 begin = std::max(start_.load(std::memory_order_relaxed),
+                                   end > CAPACITY ? end - CAPACITY : 0);
+    lines.reserve(static_cast<qsizetype>(end - begin));
+    for (quint64 i = begin; i < end; ++i) {
+        const Entry &entry = entries_[i % CAPACITY];
+        // Skip slots still being written or already lapped by a newer event
+        if (entry.sequence.load(std::memory_order_acquire) != i + 1) {
+            continue;
+        }
+        const qint64 timestampNs = entry.timestampNs.load(std::memory_order_relaxed);
+        const char *category = entry.category.load(std::memory_order_relaxed);
+        const char *event = entry.event.load(std::memory_order_relaxed);
+        const int valueCount = std::clamp(entry.valueCount.load(std::memory_order_relaxed), 0, MAX_ARGS);
+        std::array<qint64, MAX_ARGS> values = {};
+        for (int v = 0; v < valueCount; ++v) {
+            values[v] = entry.values[v].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (entry.sequence.load(std::memory_order_relaxed) != i + 1 || !event) {
+            continue;
+        }
+
+        QString text = QString::fromUtf8(event);
+        for (int v = 0; v < valueCount; ++v) {
+            text = text.arg(values[v]);
+        }
+        lines << QStringLiteral("%1 [%2] %3")
+                     .arg(QString::number(double(timestampNs) / 1e6, 'f', 3),
+                          QString::fromUtf8(category),
+                          text);
+    }
+    return lines;
+}
+
+void TraceRing::clear() {
+    start_.store(next_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
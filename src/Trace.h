@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QLoggingCategory>
+#include <QStringList>
+
+#include <array>
+#include <atomic>
+
+// Hot-path trace points. In DEBUG builds an event is recorded into a fixed-size
+// in-memory ring when its category is enabled (see QT_LOGGING_RULES, e.g.
+// "kimpanel.positioning.debug=false"); the event text is a QString::arg()
+// template that is only formatted when the ring is dumped. In release builds
+// KIMPANEL_TRACE compiles to nothing.
+Q_DECLARE_LOGGING_CATEGORY(lcTracePositioning)
+Q_DECLARE_LOGGING_CATEGORY(lcTraceLookup)
+Q_DECLARE_LOGGING_CATEGORY(lcTraceCommit)
+
+#ifdef DEBUG
+#define KIMPANEL_TRACE_ENABLED 1
+#define KIMPANEL_TRACE(category, event, ...) \
+    do { \
+        if (category().isDebugEnabled()) { \
+            TraceRing::instance().record(category().categoryName(), event __VA_OPT__(,) __VA_ARGS__); \
+        } \
+    } while (false)
+#else
+#define KIMPANEL_TRACE_ENABLED 0
+#define KIMPANEL_TRACE(category, event, ...) do {} while (false)
+#endif
+
+class TraceRing {
+public:
+    static constexpr int CAPACITY = 4096;
+    static constexpr int MAX_ARGS = 8;
+
+    static TraceRing &instance();
+
+    // event must be a string literal; values are substituted for %1..%n on dump
+    template <typename... Args>
+    void record(const char *category, const char *event, Args... args) {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "too many trace arguments");
+        const std::array<qint64, MAX_ARGS> values = {static_cast<qint64>(args)...};
+        append(category, event, values, static_cast<int>(sizeof...(Args)));
+    }
+
+    // Oldest first, one formatted line per event
+    QStringList dump() const;
+    // Drops the recorded events; slots are left to be overwritten, so writers
+    // on other threads never see the ring wiped under them
+    void clear();
+
+private:
+    // Each slot is a small seqlock: the writer marks it busy, stores the fields,
+    // then publishes its ticket with release ordering. dump() keeps a slot only
+    // if the same ticket is published before and after copying it.
+    struct Entry {
+        // Ticket + 1 once published, 0 while being written or never used
+        std::atomic<quint64> sequence{0};
+        std::atomic<qint64> timestampNs{0};
+        std::atomic<const char *> category{nullptr};
+        std::atomic<const char *> event{nullptr};
+        std::array<std::atomic<qint64>, MAX_ARGS> values = {};
+        std::atomic<int> valueCount{0};
+    };
+
+    void append(const char *category, const char *event,
+                const std::array<qint64, MAX_ARGS> &values, int count);
+
+    std::array<Entry, CAPACITY> entries_;
+    // Writers claim tickets with a relaxed counter; clear() moves start_ up to it
+    std::atomic<quint64> next_{0};
+    std::atomic<quint64> start_{0};
+};
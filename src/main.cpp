@@ -1,13 +1,21 @@
 #include <DApplication>
 
+#include <QCommandLineParser>
 #include <QDBusConnection>
 #include <QDBusMessage>
 #include <QDebug>
 
+#include <memory>
+
+#include "BusReplayer.h"
+#include "BusTrace.h"
+#include "DBusIoThread.h"
+#include "DebugService.h"
 #include "KimpanelAdaptor.h"
 #include "KimpanelInputmethodWatcher.h"
-#include "PanelWindow.h"
-#include "SystemTrayController.h"
+#include "LatencyTracker.h"
+#include "PanelHost.h"
+#include "StartupTimeline.h"
 
 DWIDGET_USE_NAMESPACE
 
@@ -17,34 +25,102 @@ static const char* IFACE1 = "org.kde.impanel";
 static const char* IFACE2 = "org.kde.impanel2";
 
 int main(int argc, char *argv[]) {
+    StartupTimeline::instance().begin();
     DApplication app(argc, argv);
     app.setQuitOnLastWindowClosed(false);
     app.setApplicationDisplayName(QStringLiteral("kimpanel-lite"));
     app.setApplicationName(QStringLiteral("kimpanel-lite"));
 
-    auto bus = QDBusConnection::sessionBus();
-    qDebug() << "[DBUS] Attempting to register service...";
-    if (!bus.registerService(SERVICE)) {
-        qDebug() << "[DBUS] Failed to register" << SERVICE << "(probably already owned)";
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption recordOption(QStringLiteral("record"),
+                                          QStringLiteral("Capture incoming panel and inputmethod traffic to <file>."),
+                                          QStringLiteral("file"));
+    const QCommandLineOption replayOption(QStringLiteral("replay"),
+                                          QStringLiteral("Play a capture back into the panel instead of serving the bus, then quit."),
+                                          QStringLiteral("file"));
+    const QCommandLineOption replayFastOption(QStringLiteral("replay-fast"),
+                                              QStringLiteral("Ignore the recorded timing when replaying."));
+    parser.addOption(recordOption);
+    parser.addOption(replayOption);
+    parser.addOption(replayFastOption);
+    parser.process(app);
+    const bool replaying = parser.isSet(replayOption);
+
+    KimpanelAdaptor adaptor;
+    std::unique_ptr<DBusIoThread> ioThread;
+    auto watcherSubscriptions = KimpanelInputmethodWatcher::Subscriptions(KimpanelInputmethodWatcher::AllSignals);
+
+    if (parser.isSet(recordOption) && !replaying) {
+        BusTraceRecorder::start(parser.value(recordOption));
+    }
+
+    if (replaying) {
+        qDebug() << "[DBUS] Replaying; not claiming" << SERVICE;
+    } else if (DBusIoThread::isRequested()) {
+        qDebug() << "[DBUS] Handling panel traffic on a dedicated I/O thread";
+        ioThread = std::make_unique<DBusIoThread>(&adaptor);
+        if (!ioThread->start(SERVICE, PATH)) {
+            qFatal("Failed to register object");
+        }
+        watcherSubscriptions = KimpanelInputmethodWatcher::PropertySignals;
+        StartupTimeline::instance().mark(StartupTimeline::BusReady);
     } else {
-        qDebug() << "[DBUS] Successfully registered" << SERVICE;
+        auto bus = QDBusConnection::sessionBus();
+        // Export the adaptor before owning the name so no early call finds an empty path
+        qDebug() << "[DBUS] Registering object at path" << PATH;
+        if (!bus.registerObject(PATH, &adaptor,
+            QDBusConnection::ExportAllSlots | QDBusConnection::ExportScriptableSlots)) {
+            qFatal("Failed to register object");
+        }
+        qDebug() << "[DBUS] Object registered successfully";
+
+        qDebug() << "[DBUS] Attempting to register service...";
+        if (!bus.registerService(SERVICE)) {
+            qDebug() << "[DBUS] Failed to register" << SERVICE << "(probably already owned)";
+        } else {
+            qDebug() << "[DBUS] Successfully registered" << SERVICE;
+        }
+        StartupTimeline::instance().mark(StartupTimeline::BusReady);
     }
 
-    KimpanelAdaptor adaptor;
-    qDebug() << "[DBUS] Registering object at path" << PATH;
-    if (!bus.registerObject(PATH, &adaptor,
-        QDBusConnection::ExportAllSlots | QDBusConnection::ExportScriptableSlots)) {
-        qFatal("Failed to register object");
+    DebugService debugService;
+    QDBusConnection panelBus = ioThread ? ioThread->connection() : QDBusConnection::sessionBus();
+    if (!panelBus.registerObject(DebugService::path(), &debugService, QDBusConnection::ExportScriptableSlots)) {
+        qWarning() << "[DBUS] Failed to register debug object at" << DebugService::path();
     }
-    qDebug() << "[DBUS] Object registered successfully";
 
-    KimpanelInputmethodWatcher inputWatcher(&adaptor);
+    std::unique_ptr<KimpanelInputmethodWatcher> inputWatcher;
+    if (!replaying) {
+        inputWatcher = std::make_unique<KimpanelInputmethodWatcher>(&adaptor, QDBusConnection::sessionBus(),
+                                                                    watcherSubscriptions);
+    }
 
-    PanelWindow panel(&adaptor);
-    panel.hide();
+    // Panel window and tray are built on first use or shortly after startup
+    PanelHost host(&adaptor);
+    QObject::connect(&host, &PanelHost::panelCreated, &debugService, [&debugService](PanelWindow *panel) {
+        debugService.setPanel(panel);
+    });
+    QObject::connect(&debugService, &DebugService::cycleInputMethodRequested,
+                     &host, &PanelHost::cycleInputMethod);
 
-    SystemTrayController trayController(&adaptor, &app);
+    BusReplayer replayer(&adaptor);
+    if (replaying) {
+        if (!replayer.open(parser.value(replayOption))) {
+            qCritical() << "[Replay] Cannot read" << parser.value(replayOption) << replayer.errorString();
+            return 1;
+        }
+        QObject::connect(&replayer, &BusReplayer::finished, &app, &QCoreApplication::quit, Qt::QueuedConnection);
+        replayer.start(parser.isSet(replayFastOption) ? BusReplayer::AsFastAsPossible : BusReplayer::OriginalPace);
+    }
 
+    QObject::connect(&app, &QCoreApplication::aboutToQuit, []() {
+        BusTraceRecorder::stop();
+        const QStringList report = LatencyTracker::instance().report();
+        for (const QString &line : report) {
+            qInfo().noquote() << "[Latency]" << line;
+        }
+    });
 
     return app.exec();
 }